@@ -0,0 +1,156 @@
+/**
+ * happy-fractal - A study of efficient and precise fractal rendering.
+ * Copyright (C) 2022  Clyne Sullivan
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef HAPPY_FRACTAL_ARENA_H
+#define HAPPY_FRACTAL_ARENA_H
+
+#include <cstddef>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+#include <sys/mman.h>
+
+#include "memory.h"
+
+/**
+ * A bump allocator over one large mapping, backed by huge pages unless asked
+ * otherwise. Allocations are cache-line aligned and are only released all at
+ * once by reset(), so nothing is handed back to the system while rendering.
+ */
+class Arena
+{
+public:
+    constexpr static std::size_t ALIGNMENT = 64;
+    constexpr static std::size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+    enum class Pages {
+        Huge,
+        // For memory that several NUMA nodes write their own parts of. A huge
+        // page would be placed wholly on the node that touched it first.
+        Small
+    };
+
+    // Maps at least the given number of bytes, recording them in the
+    // MemoryLedger under the given use. If optional, throws std::bad_alloc
+    // when the mapping would not fit in the memory budget.
+    explicit Arena(std::size_t capacity, MemoryUse use, bool optional = false, Pages pages = Pages::Huge);
+    Arena(Arena&& other);
+    Arena(const Arena&) = delete;
+    ~Arena();
+
+    // Returns storage for count objects of type T. The memory is not touched,
+    // so the first thread to write it decides where it is placed.
+    // Throws std::bad_alloc if the arena is full.
+    template<typename T>
+    std::span<T> allocate(std::size_t count);
+
+    // Releases every allocation made so far.
+    void reset();
+
+    std::size_t used() const;
+    std::size_t capacity() const;
+    // True if explicit huge pages were available; else we only ask for transparent ones.
+    bool hugePages() const;
+
+private:
+    std::byte *m_base;
+    std::size_t m_capacity;
+    std::size_t m_used;
+    bool m_huge;
+    MemoryUse m_use;
+};
+
+inline Arena::Arena(std::size_t capacity, MemoryUse use, bool optional, Pages pages):
+    m_base(nullptr),
+    m_capacity((capacity + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE),
+    m_used(0),
+    m_huge(pages == Pages::Huge),
+    m_use(use)
+{
+    if (!MemoryLedger::get().reserve(m_use, m_capacity, optional))
+        throw std::bad_alloc();
+
+    void *mem = MAP_FAILED;
+    if (m_huge) {
+        mem = mmap(nullptr, m_capacity, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+
+    if (mem == MAP_FAILED) {
+        // No reserved huge pages; fall back to transparent huge pages, or
+        // keep those away too if small pages were asked for.
+        m_huge = false;
+        mem = mmap(nullptr, m_capacity, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED) {
+            MemoryLedger::get().release(m_use, m_capacity);
+            throw std::bad_alloc();
+        }
+
+        madvise(mem, m_capacity, pages == Pages::Huge ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+    }
+
+    m_base = static_cast<std::byte *>(mem);
+}
+
+inline Arena::Arena(Arena&& other):
+    m_base(std::exchange(other.m_base, nullptr)),
+    m_capacity(std::exchange(other.m_capacity, 0)),
+    m_used(std::exchange(other.m_used, 0)),
+    m_huge(other.m_huge),
+    m_use(other.m_use) {}
+
+inline Arena::~Arena() {
+    if (m_base) {
+        munmap(m_base, m_capacity);
+        MemoryLedger::get().release(m_use, m_capacity);
+    }
+}
+
+template<typename T>
+std::span<T> Arena::allocate(std::size_t count)
+{
+    static_assert(std::is_trivially_copyable_v<T> && alignof(T) <= ALIGNMENT);
+
+    const auto offset = (m_used + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    if (count > (m_capacity - offset) / sizeof(T))
+        throw std::bad_alloc();
+
+    m_used = offset + count * sizeof(T);
+    return {reinterpret_cast<T *>(m_base + offset), count};
+}
+
+inline void Arena::reset() {
+    m_used = 0;
+}
+
+inline std::size_t Arena::used() const {
+    return m_used;
+}
+
+inline std::size_t Arena::capacity() const {
+    return m_capacity;
+}
+
+inline bool Arena::hugePages() const {
+    return m_huge;
+}
+
+#endif // HAPPY_FRACTAL_ARENA_H
@@ -0,0 +1,93 @@
+/**
+ * happy-fractal - A study of efficient and precise fractal rendering.
+ * Copyright (C) 2022  Clyne Sullivan
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef HAPPY_FRACTAL_CALIBRATION_H
+#define HAPPY_FRACTAL_CALIBRATION_H
+
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string>
+
+/**
+ * Records which number type is fastest, while still correct, on each of this
+ * machine's backends at each zoom depth. Depth d covers the zoom factors
+ * [2^-d, 2^-(d-1)). A depth without an entry uses the closest deeper one,
+ * whose type is at least as precise as needed.
+ *
+ * The table is kept in a text file, a line for each entry:
+ *     <backend> <depth> <type name>
+ */
+class CalibrationTable
+{
+public:
+    // Reads the table at path. A missing file gives an empty table.
+    explicit CalibrationTable(std::filesystem::path path);
+
+    // Returns the name of the type recorded for the backend at depth, or
+    // nullptr if nothing is recorded that deep.
+    const std::string *lookup(const std::string& backend, int depth) const;
+    void record(const std::string& backend, int depth, const std::string& type);
+
+    // Writes the table to its file. Throws std::runtime_error on failure.
+    void save() const;
+
+private:
+    std::filesystem::path m_path;
+    std::map<std::string, std::map<int, std::string>> m_types; // By backend, then depth.
+};
+
+inline CalibrationTable::CalibrationTable(std::filesystem::path path):
+    m_path(std::move(path))
+{
+    std::ifstream file (m_path);
+    std::string backend, type;
+    int depth;
+
+    while (file >> backend >> depth >> std::ws && std::getline(file, type))
+        m_types[backend][depth] = type;
+}
+
+inline const std::string *CalibrationTable::lookup(const std::string& backend, int depth) const
+{
+    const auto types = m_types.find(backend);
+    if (types == m_types.end())
+        return nullptr;
+
+    const auto entry = types->second.lower_bound(depth);
+    return entry != types->second.end() ? &entry->second : nullptr;
+}
+
+inline void CalibrationTable::record(const std::string& backend, int depth, const std::string& type) {
+    m_types[backend][depth] = type;
+}
+
+inline void CalibrationTable::save() const
+{
+    std::ofstream file (m_path);
+    for (const auto& [backend, types] : m_types) {
+        for (const auto& [depth, type] : types)
+            file << backend << ' ' << depth << ' ' << type << '\n';
+    }
+
+    if (!file.good())
+        throw std::runtime_error("Failed to write " + m_path.string());
+}
+
+#endif // HAPPY_FRACTAL_CALIBRATION_H
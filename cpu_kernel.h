@@ -0,0 +1,135 @@
+/**
+ * happy-fractal - A study of efficient and precise fractal rendering.
+ * Copyright (C) 2022  Clyne Sullivan
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef HAPPY_FRACTAL_CPU_KERNEL_H
+#define HAPPY_FRACTAL_CPU_KERNEL_H
+
+// Compiles the OpenCL kernel as C++ for the CPU backend. Besides main.cpp,
+// this is included by the kernels that jit.h generates at runtime, so it
+// depends on nothing but the kernel sources and USE_DOUBLE/COUNT_ITERATIONS.
+
+#include <cstdint>
+#include <sys/types.h> // For ulong.
+
+// The kernel is written once; each number type's operations come from its
+// own opencl/num_*.c file.
+#define FRACTAL_KERNEL "opencl/mandelbrot_calc.c"
+
+// Define helper types and functions to allow direct inclusion of the kernel.
+
+struct double2 {
+    double x;
+    double y;
+} __attribute__ ((packed));
+struct ulong2 {
+    uint64_t lo;
+    uint64_t hi;
+} __attribute__ ((packed));
+struct ulong4 {
+    ulong2 lo;
+    ulong2 hi;
+} __attribute__ ((packed));
+
+#define __global
+
+// OpenCL built-ins used by the fixed-point kernels.
+__attribute__ ((always_inline)) inline ulong mul_hi(ulong a, ulong b) {
+    return static_cast<ulong>((static_cast<unsigned __int128>(a) * b) >> 64);
+}
+__attribute__ ((always_inline)) inline long mul_hi(long a, long b) {
+    return static_cast<long>((static_cast<__int128>(a) * b) >> 64);
+}
+__attribute__ ((always_inline)) inline ulong mad_hi(ulong a, ulong b, ulong c) {
+    return mul_hi(a, b) + c;
+}
+
+// The kernel is included inside of a struct so get_global_id() can simply
+// return the index of the pixel being worked on. Each number type gets a
+// struct of its own.
+struct CpuKernelBase {
+    unsigned int id;
+    uint64_t iterations = 0;
+
+    __attribute__ ((always_inline)) unsigned int get_global_id(unsigned int) const {
+        return id;
+    }
+    // Only used to count iterations, and each kernel object is used by one thread.
+    __attribute__ ((always_inline)) void atomic_add(unsigned int *, unsigned int value) {
+        iterations += value;
+    }
+};
+
+// The whole kernel is inlined into whatever runs it, even without
+// optimization, so that it is all compiled for the caller's ISA level (see
+// mandelbrot_calc_range() in main.cpp).
+#define __kernel __attribute__ ((always_inline))
+#define inline inline __attribute__ ((always_inline))
+
+#ifdef USE_DOUBLE
+struct CpuKernelDouble : CpuKernelBase {
+#include "opencl/num_double.c"
+#include FRACTAL_KERNEL
+};
+
+using KernelPoint = CpuKernelDouble::point_t;
+
+constexpr static const char *KERNEL_SOURCES[] = {FRACTAL_KERNEL, "opencl/num_double.c"};
+#else
+struct CpuKernelQ60 : CpuKernelBase {
+#include "opencl/num_q60.c"
+#include FRACTAL_KERNEL
+};
+
+struct CpuKernelQ92 : CpuKernelBase {
+#include "opencl/num_q92.c"
+#include FRACTAL_KERNEL
+};
+
+struct CpuKernelR128 : CpuKernelBase {
+#include "opencl/num_r128.c"
+#include FRACTAL_KERNEL
+};
+
+// The fixed-point kernels all read their points in Q4.124.
+using KernelPoint = CpuKernelR128::point_t;
+
+constexpr static const char *KERNEL_SOURCES[] = {FRACTAL_KERNEL, "opencl/num_q60.c", "opencl/num_q92.c",
+                                                 "opencl/num_r128.c"};
+#endif
+
+#undef inline
+
+// Runs the given kernel for every pixel in [begin, end).
+// Returns the number of iterations calculated if COUNT_ITERATIONS is defined.
+template<class Kernel>
+__attribute__ ((always_inline)) inline uint64_t runKernel(const KernelPoint *c_pt, uint32_t *out_it, unsigned int max_iterations,
+                          unsigned int begin, unsigned int end)
+{
+    Kernel k;
+    for (k.id = begin; k.id < end; ++k.id) {
+#ifdef COUNT_ITERATIONS
+        k.mandelbrot_calc(c_pt, out_it, max_iterations, nullptr);
+#else
+        k.mandelbrot_calc(c_pt, out_it, max_iterations);
+#endif
+    }
+
+    return k.iterations;
+}
+
+#endif // HAPPY_FRACTAL_CPU_KERNEL_H
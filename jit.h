@@ -0,0 +1,289 @@
+/**
+ * happy-fractal - A study of efficient and precise fractal rendering.
+ * Copyright (C) 2022  Clyne Sullivan
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef HAPPY_FRACTAL_JIT_H
+#define HAPPY_FRACTAL_JIT_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <dlfcn.h>
+#include <unistd.h>
+
+#include "cpu_kernel.h"
+
+/**
+ * Builds CPU kernels specialized for one number type and for this machine's
+ * instruction set; the iteration cap is passed at runtime. They are generated
+ * as C++, compiled by the system compiler on a background thread and loaded
+ * with dlopen. Compiled kernels are cached on disk under a hash of their
+ * source and compiler, so each is only compiled once while it stays among the
+ * JIT_CACHE_LIMIT most recently used. The generic kernel is used until a
+ * specialized one is ready. Loaded kernels stay loaded until destruction, as
+ * a frame may still be running one; there are only as many as number types.
+ */
+class KernelJit
+{
+public:
+    // Runs the kernel for every pixel in [begin, end); see mandelbrot_calc_range().
+    using Func = uint64_t (*)(const KernelPoint *c_pt, uint32_t *out_it, unsigned int maxIterations,
+                              unsigned int begin, unsigned int end);
+
+    KernelJit();
+    ~KernelJit();
+
+    // Returns the kernel for a number type, or nullptr if it is not ready yet.
+    // In that case it is requested, replacing any kernel that was requested before.
+    // kernel names the CpuKernel struct of the number type.
+    Func get(const char *kernel);
+
+private:
+    std::mutex m_lock;
+    std::condition_variable_any m_cv;
+    // Identifies a kernel by its CpuKernel struct.
+    using Key = std::string;
+    struct Loaded {
+        Func func;
+        void *handle;
+    };
+
+    Key m_wanted;  // The latest kernel requested. Empty if none.
+    bool m_failed; // Once a compile fails, no more are attempted.
+    std::map<Key, Loaded> m_kernels;
+    std::filesystem::path m_cache;
+    std::jthread m_thread;
+
+    void run(std::stop_token stop);
+    // Compiles (if not cached) and loads the given kernel.
+    Loaded load(const Key& key);
+    // Deletes the least recently used libraries past JIT_CACHE_LIMIT.
+    void trimCache();
+    // Returns what the compiler prints for --version.
+    static std::string compilerVersion(const std::string& compiler);
+};
+
+// The symbol that generated kernels export.
+constexpr static const char *JIT_SYMBOL = "mandelbrot_calc_range_jit";
+// The most compiled kernels kept on disk.
+constexpr static std::size_t JIT_CACHE_LIMIT = 32;
+
+inline KernelJit::KernelJit():
+    m_failed(false)
+{
+    const char *xdg = std::getenv("XDG_CACHE_HOME");
+    const char *home = std::getenv("HOME");
+    if (xdg && *xdg)
+        m_cache = std::filesystem::path(xdg) / "happy-fractal";
+    else if (home && *home)
+        m_cache = std::filesystem::path(home) / ".cache" / "happy-fractal";
+    else
+        m_cache = std::filesystem::temp_directory_path() / "happy-fractal";
+
+    m_thread = std::jthread([this](std::stop_token stop) { run(stop); });
+}
+
+inline KernelJit::~KernelJit()
+{
+    // A compile in progress is waited for.
+    m_thread.request_stop();
+    m_thread.join();
+
+    for (const auto& [key, loaded] : m_kernels)
+        dlclose(loaded.handle);
+}
+
+inline KernelJit::Func KernelJit::get(const char *kernel)
+{
+    std::scoped_lock lock (m_lock);
+    Key key (kernel);
+
+    if (auto it = m_kernels.find(key); it != m_kernels.end())
+        return it->second.func;
+
+    if (m_wanted != key) {
+        m_wanted = std::move(key);
+        m_cv.notify_one();
+    }
+
+    return nullptr;
+}
+
+inline void KernelJit::run(std::stop_token stop)
+{
+    std::unique_lock lock (m_lock);
+    const auto pending = [this] { return !m_failed && !m_wanted.empty() && !m_kernels.contains(m_wanted); };
+
+    while (m_cv.wait(lock, stop, pending)) {
+        const auto key = m_wanted;
+        lock.unlock();
+
+        Loaded loaded {};
+        try {
+            loaded = load(key);
+        } catch (const std::exception& e) {
+            std::cout << "JIT unavailable, staying on the generic kernel: " << e.what() << std::endl;
+        }
+
+        lock.lock();
+        if (loaded.func)
+            m_kernels[key] = loaded;
+        else
+            m_failed = true;
+    }
+}
+
+inline KernelJit::Loaded KernelJit::load(const Key& key)
+{
+    std::ostringstream src;
+#ifdef USE_DOUBLE
+    src << "#define USE_DOUBLE\n";
+#endif
+#ifdef COUNT_ITERATIONS
+    src << "#define COUNT_ITERATIONS\n";
+#endif
+    src << "#include \"cpu_kernel.h\"\n"
+        << "extern \"C\" uint64_t " << JIT_SYMBOL << "(const KernelPoint *c_pt, uint32_t *out_it,\n"
+        << "        unsigned int max_iterations, unsigned int begin, unsigned int end)\n"
+        << "{\n"
+        << "    return runKernel<" << key << ">(c_pt, out_it, max_iterations, begin, end);\n"
+        << "}\n";
+
+    const char *cxx = std::getenv("CXX");
+    const std::string compiler = cxx && *cxx ? cxx : "c++";
+    const auto include = std::filesystem::current_path();
+    const std::string flags = "-std=c++20 -O3 -march=native -shared -fPIC";
+
+    // The kernel sources and the compiler's version are part of the hash, so
+    // editing the sources or upgrading the compiler invalidates the cache.
+    std::ostringstream hashed;
+    hashed << compiler << ' ' << flags << '\n' << compilerVersion(compiler) << src.str();
+    std::vector<const char *> sources {"cpu_kernel.h"};
+    sources.insert(sources.end(), std::begin(KERNEL_SOURCES), std::end(KERNEL_SOURCES));
+    for (const auto path : sources) {
+        std::ifstream file (include / path);
+        if (!file.good())
+            throw std::runtime_error(std::string("Failed to open ") + path);
+        hashed << file.rdbuf();
+    }
+
+    std::ostringstream name;
+    name << std::hex << std::hash<std::string>{}(hashed.str());
+    const auto library = m_cache / (name.str() + ".so");
+
+    if (std::filesystem::exists(library)) {
+        // Marks it as recently used, for trimCache().
+        std::error_code ec;
+        std::filesystem::last_write_time(library, std::filesystem::file_time_type::clock::now(), ec);
+    } else {
+        std::filesystem::create_directories(m_cache);
+
+        // Built from and into unique temporary files, so instances compiling
+        // the same kernel never share one, nor load a partial library.
+        std::string source = (m_cache / (name.str() + ".XXXXXX.cpp")).string();
+        std::string temp = (m_cache / (name.str() + ".so.XXXXXX")).string();
+        const int sourceFd = mkstemps(source.data(), 4);
+        if (sourceFd < 0)
+            throw std::runtime_error("Failed to create " + source);
+        close(sourceFd);
+        const int tempFd = mkstemp(temp.data());
+        if (tempFd < 0) {
+            std::filesystem::remove(source);
+            throw std::runtime_error("Failed to create " + temp);
+        }
+        close(tempFd);
+
+        std::ofstream(source) << src.str();
+        const std::string command = compiler + ' ' + flags + " -I\"" + include.string() + "\" -o \"" +
+                                    temp + "\" \"" + source + '"';
+        const bool compiled = std::system(command.c_str()) == 0;
+        std::filesystem::remove(source);
+        if (!compiled) {
+            std::filesystem::remove(temp);
+            throw std::runtime_error("Failed to compile " + name.str());
+        }
+
+        std::filesystem::rename(temp, library);
+        trimCache();
+    }
+
+    void *handle = dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle)
+        throw std::runtime_error(dlerror());
+
+    auto func = reinterpret_cast<Func>(dlsym(handle, JIT_SYMBOL));
+    if (!func) {
+        dlclose(handle);
+        throw std::runtime_error(std::string("Missing ") + JIT_SYMBOL);
+    }
+
+    return {func, handle};
+}
+
+inline std::string KernelJit::compilerVersion(const std::string& compiler)
+{
+    FILE *pipe = popen((compiler + " --version").c_str(), "r");
+    if (!pipe)
+        throw std::runtime_error("Failed to run " + compiler);
+
+    std::string version;
+    char buffer[256];
+    for (std::size_t n; (n = std::fread(buffer, 1, sizeof(buffer), pipe)) > 0;)
+        version.append(buffer, n);
+
+    if (pclose(pipe) != 0)
+        throw std::runtime_error("Failed to run " + compiler + " --version");
+    return version;
+}
+
+inline void KernelJit::trimCache()
+{
+    std::vector<std::filesystem::directory_entry> libraries;
+    for (const auto& entry : std::filesystem::directory_iterator(m_cache)) {
+        if (entry.path().extension() == ".so")
+            libraries.push_back(entry);
+    }
+
+    if (libraries.size() <= JIT_CACHE_LIMIT)
+        return;
+
+    // Loaded libraries stay usable once deleted, so other instances are unaffected.
+    std::ranges::sort(libraries, std::ranges::greater {},
+                      [](const auto& entry) { return entry.last_write_time(); });
+    std::error_code ec;
+    for (auto it = libraries.begin() + JIT_CACHE_LIMIT; it != libraries.end(); ++it)
+        std::filesystem::remove(it->path(), ec);
+}
+
+#endif // HAPPY_FRACTAL_JIT_H
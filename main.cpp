@@ -20,91 +20,182 @@
 //#define BENCHMARK
 
 // If defined, split calculations across CPU threads instead of using OpenCL.
+// Otherwise, the CPU renders the first frames while OpenCL starts up.
 //#define NO_OPENCL
 
+// If defined, the CPU uses the standard parallel algorithms instead of
+// our worker pool. libstdc++ needs TBB for this (link with -ltbb).
+// Only the tiles are spread out by the library; each tile still runs the
+// same kernel as the pool, one pixel at a time.
+//#define USE_STD_EXECUTION
+
 // If defined, use double floating-point instead of fixed-point.
 //#define USE_DOUBLE
 
+// If defined, the kernel counts the iterations it calculates so energy use can
+// be reported per iteration. Under OpenCL this costs an atomic add per pixel.
+//#define COUNT_ITERATIONS
+
+// If defined, the CPU switches to kernels compiled at runtime for the current
+// number type and this machine, once they're ready. Needs a C++ compiler at
+// runtime, and the sources in the working directory.
+//#define USE_JIT
+
+// If defined, the worker pool traces the edges of each tile's equal-color
+// regions and fills in their insides without calculating them. Much cheaper
+// for views of large bands or of the set's interior, though a detail lying
+// wholly inside a region is lost.
+//#define USE_BOUNDARY_TRACING
+
+// If defined, the worker pool calculates each tile on a sparse lattice, and
+// fills in the blocks between lattice points by bilinear interpolation where
+// the whole border and a few random pixels inside are outside the set and
+// predicted within INTERPOLATION_TOLERANCE. Cheaper for views of slowly
+// varying iteration counts. The set itself is never interpolated, but other
+// pixels inside a block may still be off by more than the tolerance.
+//#define USE_INTERPOLATION
+
+// If defined, CPU frames too deep for the cheapest number type are calculated
+// by perturbation: one reference orbit at the view's center is calculated in
+// Float, and each pixel iterates its double-precision offset from it. Only
+// the fixed-point build has more than one number type, so only it does this.
+//#define USE_PERTURBATION
+
+#include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <cmath>
+#include <complex>
 #include <cstdint>
 #include <cstring>
 #include <execution>
 #include <fstream>
+#include <functional>
 #include <iomanip>
 #include <iostream>
+#include <iterator>
 #include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <random>
 #include <ranges>
+#include <span>
 #include <sstream>
 #include <stdexcept>
+#include <stop_token>
+#include <string_view>
 #include <thread>
 #include <vector>
 
 #include <SDL2/SDL.h>
 
+#include "arena.h"
+#include "calibration.h"
+#include "memory.h"
+#include "rapl.h"
+#include "task.h"
+#include "worker_pool.h"
+
 // Sets the window's dimensions. The window is square.
 constexpr static int WIN_DIM = 800;
 
-#ifdef USE_DOUBLE
-#define FRACTAL_KERNEL "opencl/mandelbrot_calc.c"
-#else
-#define FRACTAL_KERNEL "opencl/mandelbrot_calc_r128.c"
-#endif
-
 #ifndef NO_OPENCL
 // Include OpenCL libraries if they're required.
 #define CL_HPP_TARGET_OPENCL_VERSION (300)
 #define CL_HPP_ENABLE_EXCEPTIONS (1)
 #include <CL/opencl.hpp>
-#else
-// Define helper types and functions to allow direct inclusion of the kernel.
-#include <map>
+#endif
 
-struct double2 {
-    double x;
-    double y;
+// Comes after OpenCL, since it defines the kernel's types and qualifiers for C++.
+#include "cpu_kernel.h"
+#ifdef USE_JIT
+#include "jit.h"
+#endif
 
-    auto& operator+=(const double2& other) {
-        x += other.x;
-        y += other.y;
-        return *this;
-    }
-    auto& operator*=(const double2& other) {
-        x *= other.x;
-        y *= other.y;
-        return *this;
-    }
-} __attribute__ ((packed));
-struct ulong2 {
-    uint64_t lo;
-    uint64_t hi;
-} __attribute__ ((packed));
-struct ulong4 {
-    ulong2 lo;
-    ulong2 hi;
-} __attribute__ ((packed));
+// The kernel loop is compiled once for each of these ISA levels ("default" is
+// the x86-64 baseline, SSE2), with the whole kernel flattened into it so that
+// all of it uses the level's instructions. The best level for the running CPU
+// is picked at startup, so a single binary can still use AVX-512.
+enum class CpuKernelLevel { Default, Avx2, Avx512f };
+
+// Runs the given kernel for every pixel in [begin, end).
+// Returns the number of iterations calculated if COUNT_ITERATIONS is defined.
+template<class Kernel>
+__attribute__ ((flatten))
+static uint64_t mandelbrot_calc_default(const KernelPoint *c_pt, uint32_t *out_it, unsigned int max_iterations,
+                                        unsigned int begin, unsigned int end)
+{
+    return runKernel<Kernel>(c_pt, out_it, max_iterations, begin, end);
+}
 
-#define __kernel
-#define __global
-#define get_global_id(x) (globalIds[std::this_thread::get_id()])
-#ifdef USE_DOUBLE
-#define CALC_SRC_T double2
-#else
-#define CALC_SRC_T ulong4
+#if defined(__x86_64__) && defined(__GNUC__)
+template<class Kernel>
+__attribute__ ((target("avx2,fma"), flatten))
+static uint64_t mandelbrot_calc_avx2(const KernelPoint *c_pt, uint32_t *out_it, unsigned int max_iterations,
+                                     unsigned int begin, unsigned int end)
+{
+    return runKernel<Kernel>(c_pt, out_it, max_iterations, begin, end);
+}
+
+template<class Kernel>
+__attribute__ ((target("avx512f"), flatten))
+static uint64_t mandelbrot_calc_avx512f(const KernelPoint *c_pt, uint32_t *out_it, unsigned int max_iterations,
+                                        unsigned int begin, unsigned int end)
+{
+    return runKernel<Kernel>(c_pt, out_it, max_iterations, begin, end);
+}
 #endif
 
-static std::map<std::thread::id, unsigned int> globalIds;
-static std::array<uint32_t, WIN_DIM * WIN_DIM> renderOutput;
+static const CpuKernelLevel CPU_KERNEL_LEVEL = [] {
+#if defined(__x86_64__) && defined(__GNUC__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return CpuKernelLevel::Avx512f;
+    else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return CpuKernelLevel::Avx2;
+#endif
+    return CpuKernelLevel::Default;
+}();
 
-#include FRACTAL_KERNEL
+// Runs the version of the kernel for CPU_KERNEL_LEVEL.
+template<class Kernel>
+static uint64_t mandelbrot_calc_range(const KernelPoint *c_pt, uint32_t *out_it, unsigned int max_iterations,
+                                      unsigned int begin, unsigned int end)
+{
+    switch (CPU_KERNEL_LEVEL) {
+#if defined(__x86_64__) && defined(__GNUC__)
+    case CpuKernelLevel::Avx512f:
+        return mandelbrot_calc_avx512f<Kernel>(c_pt, out_it, max_iterations, begin, end);
+    case CpuKernelLevel::Avx2:
+        return mandelbrot_calc_avx2<Kernel>(c_pt, out_it, max_iterations, begin, end);
 #endif
+    default:
+        return mandelbrot_calc_default<Kernel>(c_pt, out_it, max_iterations, begin, end);
+    }
+}
 
-// For non-OpenCL rendering, the number of threads to split work across.
-constexpr static int THREAD_COUNT = 8;
+// Returns the name of the kernel version that mandelbrot_calc_range() runs.
+static const char *cpuKernelTarget()
+{
+    switch (CPU_KERNEL_LEVEL) {
+    case CpuKernelLevel::Avx512f: return "avx512f";
+    case CpuKernelLevel::Avx2:    return "avx2";
+#if defined(__x86_64__)
+    default:                      return "sse2";
+#else
+    default:                      return "default";
+#endif
+    }
+}
+
+// The number of worker threads to split work across.
+// Zero starts one thread per physical core.
+constexpr static unsigned int THREAD_COUNT = 0;
 
 // The "Float" type determines what data type will store numbers for calculations.
 // Can use native float or double; or, a custom Q4.124 fixed-point data type.
-// If fixed point, use "*_r128.c" OpenCL kernel. Otherwise, use regular kernel.
+// With fixed point, the kernel may calculate in fewer bits; see NUM_TYPES.
 
 #ifdef USE_DOUBLE
 using Float = double;
@@ -114,6 +205,49 @@ using Float = double;
 using Float = R128;
 #endif
 
+// A number type that the kernel is built for.
+struct NumType {
+    const char *name;
+    const char *source;    // Its operations, for OpenCL.
+    const char *cpuKernel; // Its CpuKernel struct, for the JIT.
+    int fractionBits;
+    uint64_t (*calculate)(const KernelPoint *, uint32_t *, unsigned int, unsigned int, unsigned int);
+};
+
+// The number types to calculate in, cheapest first. Each frame uses the
+// first one precise enough for its zoom. Fixed-point points are always given
+// in Q4.124, and truncated by the narrower types.
+#ifdef USE_DOUBLE
+static const NumType NUM_TYPES[] = {
+    {"double", "opencl/num_double.c", "CpuKernelDouble", 52, mandelbrot_calc_range<CpuKernelDouble>},
+};
+#else
+static const NumType NUM_TYPES[] = {
+    {"Q4.60", "opencl/num_q60.c", "CpuKernelQ60", 60, mandelbrot_calc_range<CpuKernelQ60>},
+    {"Q4.92", "opencl/num_q92.c", "CpuKernelQ92", 92, mandelbrot_calc_range<CpuKernelQ92>},
+    {"Q4.124", "opencl/num_r128.c", "CpuKernelR128", 124, mandelbrot_calc_range<CpuKernelR128>},
+};
+#endif
+constexpr static unsigned int NUM_TYPE_COUNT = std::size(NUM_TYPES);
+
+// A number type is precise enough while the pixels are at least this many
+// bits' worth of its smallest step apart. The iterations lose some bits along the way.
+constexpr static int PRECISION_MARGIN = 12;
+
+// Where "--calibrate" records the fastest correct number type for each
+// backend and depth on this machine. Frames pick their type from it, and
+// fall back to PRECISION_MARGIN where it has no entry.
+constexpr static const char *CALIBRATION_FILE = "calibration.txt";
+// Calibration measures a square of this many pixels per side, out of a frame
+// at every CALIBRATION_STEP'th depth.
+constexpr static unsigned int CALIBRATION_DIM = 64;
+constexpr static int CALIBRATION_STEP = 4;
+// A type is correct if at most this fraction of pixels differ from the most
+// precise type. Rounding alone changes a few percent, close to the boundary;
+// a type short of bits gets most of them wrong. A view where all but twice
+// this fraction of pixels match the center one has too little detail to check by.
+constexpr static double CALIBRATION_TOLERANCE = 0.05;
+
 // Not allowed to calculate less iterations than this.
 constexpr uint32_t MIN_MAX_ITERATIONS = 70;
 // Not allowed to zoom out farther than this.
@@ -128,20 +262,102 @@ struct Complex {
     Float imag = Float(0);
 } __attribute__ ((packed));
 
+// For non-OpenCL rendering, the time a frame may take before tiles are left
+// unfinished and filled in from the previous frame. Zero waits for every tile.
+constexpr static std::chrono::milliseconds FRAME_BUDGET (0);
+// How long the view must stay still before those tiles are finished by another
+// frame of the same view. Longer than a frame of user input, so zooming isn't held up.
+constexpr static std::chrono::milliseconds FOLLOW_UP_DELAY (20);
+
+// For non-OpenCL rendering, frames are split into square tiles of this size.
+constexpr static unsigned int TILE_DIM = 32;
+constexpr static unsigned int TILES_PER_ROW = WIN_DIM / TILE_DIM;
+constexpr static unsigned int TILE_COUNT = TILES_PER_ROW * TILES_PER_ROW;
+static_assert(WIN_DIM % TILE_DIM == 0);
+
+#if defined(USE_BOUNDARY_TRACING) && defined(USE_INTERPOLATION)
+#error "Only one of USE_BOUNDARY_TRACING and USE_INTERPOLATION may be defined."
+#endif
+// For interpolation, the lattice spacing, and how many random pixels inside
+// each block are checked besides its border. A block is filled in if all the
+// checked pixels are outside the set, and within this many iterations of their prediction.
+constexpr static unsigned int INTERPOLATION_BLOCK = 8;
+constexpr static unsigned int INTERPOLATION_SAMPLES = 3;
+constexpr static int INTERPOLATION_TOLERANCE = 1;
+static_assert(TILE_DIM % INTERPOLATION_BLOCK == 0);
+
+// Large enough for every per-frame buffer, plus room for alignment.
+constexpr static std::size_t FRAME_ARENA_SIZE =
+    WIN_DIM * WIN_DIM * (sizeof(Complex) + sizeof(uint32_t)) + 2 * WIN_DIM * sizeof(Float) +
+    2 * TILE_COUNT * sizeof(bool) + 16 * Arena::ALIGNMENT;
+// For non-OpenCL rendering, room to keep the previous frame. This is optional.
+constexpr static std::size_t HISTORY_ARENA_SIZE =
+    WIN_DIM * WIN_DIM * sizeof(uint32_t) + TILE_COUNT * sizeof(bool) + 4 * Arena::ALIGNMENT;
+#ifndef NO_OPENCL
+// The device memory taken by the OpenCL input and output buffers.
+constexpr static std::size_t CL_BUFFER_SIZE = WIN_DIM * WIN_DIM * (sizeof(Complex) + sizeof(uint32_t));
+// If OpenCL runs on the CPU, the number of compute units (cores) kept out of
+// its reach, so the event and presentation threads stay responsive.
+constexpr static unsigned int CL_RESERVED_CORES = 2;
+// Vectorized kernels take pixels in groups of up to eight.
+static_assert(WIN_DIM * WIN_DIM % 8 == 0);
+#endif
+// Per-thread scratch space for a single frame.
+constexpr static std::size_t SCRATCH_ARENA_SIZE = Arena::HUGE_PAGE_SIZE;
+
+// The memory, host and device, that the program should stay within. Required
+// buffers are allocated regardless; optional ones (e.g. frame history) are
+// left out if they don't fit. Zero is unlimited.
+constexpr static std::size_t MEMORY_BUDGET = 0;
+
+#ifdef USE_STD_EXECUTION
+// The standard algorithms need a range of tile indices to iterate over.
+constexpr static auto TILE_INDICES = [] {
+    std::array<unsigned int, TILE_COUNT> tiles {};
+    std::iota(tiles.begin(), tiles.end(), 0u);
+    return tiles;
+}();
+#endif
+
+// Names the CPU backend, for benchmark results.
+#ifdef USE_STD_EXECUTION
+constexpr static const char *CPU_BACKEND_NAME = "std::execution";
+#else
+constexpr static const char *CPU_BACKEND_NAME = "worker pool";
+#endif
+
 class MandelbrotState
 {
 public:
-    // Initializes data and spawns the calculation thread.
-    MandelbrotState();
-    // Joins threads.
+    // Initializes data. Calculations are run on the given pool, which may be
+    // shared by any number of MandelbrotStates. Views doing background work
+    // (exports, refinement) should use Batch priority, so that interactive
+    // views sharing the pool stay responsive.
+    explicit MandelbrotState(WorkerPool& pool, WorkerPool::Priority priority = WorkerPool::Priority::Interactive);
+    // Cancels the calculation in progress.
     ~MandelbrotState();
 
 #ifndef NO_OPENCL
-    // Prepares to use the given OpenCL kernel for calculations.
-    void initKernel(cl::Context& clcontext, cl::Program& clprogram, const char *kernelname);
+    // Prepares to use the given OpenCL kernel for calculations. May be called
+    // from any thread; the CPU is used until the next frame takes it up.
+    // There is a program for each of NUM_TYPES, and each work-item of the
+    // kernel calculates vectorWidth pixels.
+    void initKernel(cl::Context& clcontext, std::vector<cl::Program>& clprograms, const char *kernelname,
+                    unsigned int vectorWidth = 1);
 #endif
+    // Names the backend that rendered the latest frame.
+    const char *backendName() const;
+    // Names the number type that the latest frame was calculated in, or
+    // "perturbation" if it was calculated by perturbation.
+    const char *numTypeName() const;
 
     Float zoom() const;
+    // Returns the number of iterations calculated so far. Always zero unless
+    // COUNT_ITERATIONS is defined.
+    uint64_t iterations() const;
+
+    // Sets the pixel the user is looking at. Tiles closest to it are calculated first.
+    void setFocus(int x, int y);
 
     // Offsets the view's origin by the given Complex, and changes zoom by the given factor.
     // Returns true if a new calculation has been scheduled (false if one is in progress).
@@ -153,46 +369,163 @@ public:
     bool intoTexture(SDL_Texture *texture);
     // Requests the initiation of a new calculation.
     void scheduleRecalculation();
+    // True if no tile of the latest texture was filled in from an earlier
+    // frame. Otherwise, another frame of the same view is already on its way.
+    bool exact() const;
+
+    // Times every number type on every backend ready so far, over views of
+    // increasing depth, and saves the fastest correct ones to CALIBRATION_FILE.
+    // Must not be called while a frame is rendering.
+    void calibrate();
 
 private:
-    std::thread m_calc_thread;
-    std::atomic_bool m_calcing; // If false, we're ready for a new calculation.
-    std::atomic_flag m_recalc;  // Tell calcThread to recalc, or tell main thread recalcing is done.
+    // A frame goes from Idle to Rendering to Ready, then back to Idle once shown.
+    enum class FrameState { Idle, Rendering, Ready };
+
+    std::atomic<FrameState> m_state; // If Idle, we're ready for a new calculation.
+    std::mutex m_state_lock;         // Held while a finished frame notifies m_state.
+    std::stop_source m_stop;         // Cancels the frame being rendered.
+    std::chrono::time_point<std::chrono::high_resolution_clock> m_calc_start;
+    std::chrono::time_point<std::chrono::high_resolution_clock> m_shown; // When the latest frame was uploaded.
     uint32_t m_max_iterations;
+    unsigned int m_num_type; // Indexes NUM_TYPES.
+    CalibrationTable m_calibration;
     Float m_zoom;
     Complex m_origin;
+    std::atomic_int m_focus_x;
+    std::atomic_int m_focus_y;
+    std::atomic<uint64_t> m_iterations;
+
+    // Backs the per-frame buffers below. Like the history arena, it uses small
+    // pages, so each NUMA node's tiles are placed on that node at first touch.
+    Arena m_frame_arena;
+    std::span<Complex> m_points; // The Complex coordinate of every pixel.
+    std::span<Float> m_row;
+    std::span<Float> m_col;
+    // Frames are double-buffered: the previous frame fills in for any tiles
+    // the current one could not finish in time. If the history arena didn't
+    // fit in the memory budget, the m_prev_* spans are empty.
+    std::optional<Arena> m_history_arena;
+    std::span<uint32_t> m_output;
+    std::span<uint32_t> m_prev_output;
+    std::span<bool> m_tile_exact; // False if a tile was filled in from the previous frame.
+    std::span<bool> m_prev_tile_exact;
+    bool m_exact = true; // Whether every tile of the latest texture was exact.
+    std::span<bool> m_tile_dirty; // True if a tile differs from the frame before it.
+    Float m_prev_zoom;
+    Complex m_prev_origin;
+
+#ifdef USE_JIT
+    KernelJit m_jit;
+    KernelJit::Func m_jit_kernel = nullptr; // The specialized kernel for this frame, if ready.
+#endif
+
+#ifdef USE_PERTURBATION
+    bool m_perturb = false;                      // True if this frame is calculated by perturbation.
+    std::vector<std::complex<double>> m_orbit;   // The reference orbit, from zero until it escapes.
+#endif
 
 #ifndef NO_OPENCL
-    std::unique_ptr<cl::Kernel> m_cl_kernel;
-    std::unique_ptr<cl::CommandQueue> m_cl_queue;
-    std::unique_ptr<cl::Buffer> m_cl_input;
-    std::unique_ptr<cl::Buffer> m_cl_output;
+    // Everything needed to run the OpenCL kernel.
+    struct ClBackend {
+        cl::CommandQueue queue;
+        std::vector<cl::Kernel> kernels; // One for each of NUM_TYPES.
+        cl::Buffer input;
+        cl::Buffer output;
+#ifdef COUNT_ITERATIONS
+        cl::Buffer iterations;
 #endif
+        unsigned int vectorWidth;
 
-    // Enters main loop of calcThread.
-    void calcThread();
-    // Calls the OpenCL kernel to compute new results.
-    void calculateBitmap();
+        ClBackend(cl::Context& clcontext, std::vector<cl::Program>& clprograms, const char *kernelname,
+                  unsigned int vectorWidth);
+        ~ClBackend();
+    };
+
+    std::mutex m_cl_lock;                    // Guards m_cl_pending.
+    std::unique_ptr<ClBackend> m_cl_pending; // Set by initKernel(), until a frame takes it up.
+    std::unique_ptr<ClBackend> m_cl;         // Only changed while a frame is rendering.
+#endif
+    std::atomic_bool m_on_device;            // True once m_cl is in use.
+
+    WorkerPool& m_pool;
+    WorkerPool::Priority m_priority;
+
+    // Starts rendering a frame. m_state must already be Rendering.
+    void startFrame();
+    // Renders a frame, one stage at a time, on the worker pool.
+    Task renderFrame(std::stop_token stop);
+    // Generates the Complex coordinates of the new frame.
+    void preparePoints();
+    // Calls the kernel to compute new results.
+    Task calculateBitmap(std::stop_token stop);
+    // Runs the CPU kernel over the given pixels, whose points must be filled in.
+    // Uses the JIT's specialized kernel when there is one.
+    uint64_t calculateRange(unsigned int begin, unsigned int end);
+    // Calculates m_orbit at the view's center, for perturbation.
+    void calculateReference();
+    // Like calculateRange(), but by perturbation from m_orbit.
+    uint64_t perturbRange(unsigned int begin, unsigned int end);
+    // Fills in the points of the given tile, then computes its results.
+    // Returns the number of iterations calculated, as does zoomOutTile().
+    uint64_t calculateTile(unsigned int tile);
+    // Like calculateTile(), but only calculates the pixels along the edges of
+    // regions of one color, filling in the rest. Uses the worker's scratch arena.
+    uint64_t traceTile(unsigned int tile, Arena& scratch);
+    // Like calculateTile(), but fills in blocks that interpolate well from
+    // their corners. Uses the worker's scratch arena.
+    uint64_t interpolateTile(unsigned int tile, Arena& scratch);
+    // Fills in the given tile by scaling and moving the previous frame to the
+    // current view, as (x, y) -> (x * scale + dx, y * scale + dy).
+    void reprojectTile(unsigned int tile, double scale, double dx, double dy);
+    // Like reprojectTile(), for a view that is zoomed out from (or panned from)
+    // the previous one. Pixels are only copied if the previous frame agrees all
+    // around them; the rest, including any outside the previous frame, are calculated.
+    uint64_t zoomOutTile(unsigned int tile, double scale, double dx, double dy);
+    // Copies the tiles the CPU changed in the latest frame into the texture.
+    void uploadDirtyTiles(SDL_Texture *texture);
 
     // Determine the max iteration count based on zoom factor.
     static uint32_t calculateMaxIterations(Float zoom);
+    // Picks the number type for the zoom factor on the current backend: the
+    // calibrated one if there is one, else the cheapest precise enough.
+    unsigned int numTypeFor(Float zoom) const;
+    // Picks the cheapest of NUM_TYPES that is precise enough for the zoom
+    // factor, i.e. has margin bits to spare between its pixels.
+    static unsigned int preciseTypeFor(Float zoom, int margin = PRECISION_MARGIN);
+    // Returns the calibration depth of the zoom factor.
+    static int zoomDepth(Float zoom);
+    // Runs the given number type over the first count points on the current
+    // backend. Returns the seconds taken.
+    double timeNumType(unsigned int type, const Complex *points, uint32_t *output, unsigned int count,
+                       uint32_t maxIterations);
 };
 
 static bool done = false;
 static std::atomic_int fps = 0;
-static std::chrono::time_point<std::chrono::high_resolution_clock> clTime;
 
 #ifndef NO_OPENCL
 static cl::Context initCLContext();
-static cl::Program initCLProgram(cl::Context&, const char * const);
+static unsigned int clVectorWidth();
+static cl::Program initCLProgram(cl::Context&, const char * const, unsigned int);
 #endif
 static void initSDL(SDL_Window **, SDL_Renderer **, SDL_Texture **);
-static void threadFpsMonitor(MandelbrotState&);
+static void threadFpsMonitor(MandelbrotState&, WorkerPool&);
+static void printEnergy(double joules, unsigned int frames, uint64_t iterations);
+static void printMemory();
 static void threadEventMonitor(MandelbrotState&);
 
 int main(int argc, char **argv)
 {
-    MandelbrotState Mandelbrot;
+    const auto startTime = std::chrono::high_resolution_clock::now();
+    MemoryLedger::get().setBudget(MEMORY_BUDGET);
+
+    const auto topo = CpuTopology::detect();
+    WorkerPool pool (topo, THREAD_COUNT, SCRATCH_ARENA_SIZE);
+    std::cout << "Workers: " << pool.size() << " on " << topo.cores.size() << " core(s) across "
+              << pool.nodeCount() << " NUMA node(s)" << std::endl;
+
+    MandelbrotState Mandelbrot (pool);
     SDL_Window *window;
     SDL_Renderer *renderer;
     SDL_Texture *MandelbrotTexture;
@@ -200,27 +533,68 @@ int main(int argc, char **argv)
     initSDL(&window, &renderer, &MandelbrotTexture);
 
 #ifndef NO_OPENCL
-    std::ifstream clSource (FRACTAL_KERNEL);
-    if (!clSource.good())
-        throw std::runtime_error("Failed to open OpenCL kernel!");
+    // Starting OpenCL can take seconds, mostly in building the kernel. The
+    // CPU renders in the meantime, and OpenCL takes over once it's ready.
+    std::thread clInit ([&Mandelbrot, startTime] {
+        try {
+            auto clContext = initCLContext();
+            const auto width = clVectorWidth();
+
+            // Each number type is a program of its own.
+            std::vector<cl::Program> clPrograms;
+            for (const auto& type : NUM_TYPES) {
+                // Dump the number type and OpenCL kernel into a std::string.
+                std::ostringstream oss;
+                for (const auto path : {type.source, FRACTAL_KERNEL}) {
+                    std::ifstream clSource (path);
+                    if (!clSource.good())
+                        throw std::runtime_error("Failed to open OpenCL kernel!");
+                    oss << clSource.rdbuf() << '\n';
+                }
+                std::string clSourceStr (oss.str());
+
+                clPrograms.push_back(initCLProgram(clContext, clSourceStr.data(), width));
+            }
 
-    // Dump OpenCL kernel into a std::string.
-    std::ostringstream oss;
-    oss << clSource.rdbuf();
-    std::string clSourceStr (oss.str());
+            Mandelbrot.initKernel(clContext, clPrograms, width > 1 ? "mandelbrot_calc_vec" : "mandelbrot_calc", width);
+
+            std::chrono::duration<double> seconds = std::chrono::high_resolution_clock::now() - startTime;
+            std::cout << "OpenCL ready after " << seconds.count() << "s" << std::endl;
+        } catch (const std::exception& e) {
+            std::cout << "OpenCL unavailable, staying on the CPU: " << e.what() << std::endl;
+        }
+    });
 
-    auto clContext = initCLContext();
-    auto clProgram = initCLProgram(clContext, clSourceStr.data());
-    Mandelbrot.initKernel(clContext, clProgram, "mandelbrot_calc");
+#ifdef BENCHMARK
+    // Benchmark OpenCL alone.
+    clInit.join();
+#endif
 #endif
 
+    if (argc > 1 && std::string_view(argv[1]) == "--calibrate") {
+#ifndef NO_OPENCL
+        if (clInit.joinable())
+            clInit.join();
+#endif
+        Mandelbrot.calibrate();
+        SDL_DestroyRenderer(renderer);
+        return 0;
+    }
+
+    std::cout << "CPU kernel: " << cpuKernelTarget() << std::endl;
+    printMemory();
+
     // Initiate first calculation so something appears on the screen.
     Mandelbrot.scheduleRecalculation();
 
-    std::thread fpsMonitor ([&Mandelbrot] { threadFpsMonitor(Mandelbrot); });
+    std::thread fpsMonitor ([&Mandelbrot, &pool] { threadFpsMonitor(Mandelbrot, pool); });
     std::thread eventMonitor ([&Mandelbrot] { threadEventMonitor(Mandelbrot); });
 
+    bool shown = false;
+
 #ifdef BENCHMARK
+    EnergyMeter energy;
+    unsigned int frames = 0;
     auto start = std::chrono::high_resolution_clock::now();
 #endif
 
@@ -230,7 +604,17 @@ int main(int argc, char **argv)
             SDL_RenderCopy(renderer, MandelbrotTexture, nullptr, nullptr);
             SDL_RenderPresent(renderer);
 
+            if (!shown) {
+                std::chrono::duration<double> seconds = std::chrono::high_resolution_clock::now() - startTime;
+                std::cout << "Time to first frame: " << seconds.count() << "s (" << Mandelbrot.backendName() << ")"
+                          << std::endl;
+                shown = true;
+            }
+
             ++fps;
+#ifdef BENCHMARK
+            ++frames;
+#endif
         } else {
             std::this_thread::sleep_for(std::chrono::microseconds(10));
         }
@@ -243,11 +627,37 @@ int main(int argc, char **argv)
 
 #ifdef BENCHMARK
     std::chrono::duration<double> seconds = std::chrono::high_resolution_clock::now() - start;
-    std::cout << "Calculations took: " << seconds.count() << "s" << std::endl;
+    std::cout << "Calculations took: " << seconds.count() << "s (" << Mandelbrot.backendName() << ")" << std::endl;
+    if (energy.available()) {
+        const auto joules = energy.joules();
+        std::cout << "Energy: " << joules << " J, ";
+        printEnergy(joules, frames, Mandelbrot.iterations());
+        std::cout << " (" << Mandelbrot.backendName() << ", " << Mandelbrot.numTypeName() << ")" << std::endl;
+    } else {
+        std::cout << "Energy: unavailable (no readable RAPL counters)" << std::endl;
+    }
 #endif
 
     eventMonitor.join();
     fpsMonitor.join();
+
+#ifdef BENCHMARK
+    // With a frame budget, the last view may still show tiles taken from
+    // earlier frames. It must finish them by itself, with no further input.
+    unsigned int extraFrames = 0;
+    for (;;) {
+        if (Mandelbrot.intoTexture(MandelbrotTexture))
+            ++extraFrames;
+        else if (Mandelbrot.exact())
+            break;
+        else
+            std::this_thread::sleep_for(std::chrono::microseconds(10));
+    }
+    std::cout << "Last view exact after " << extraFrames << " more frame(s)" << std::endl;
+#endif
+#if !defined(NO_OPENCL) && !defined(BENCHMARK)
+    clInit.join();
+#endif
     SDL_DestroyRenderer(renderer);
     return 0;
 }
@@ -259,18 +669,69 @@ static std::vector<cl::Device> cldevices;
 cl::Context initCLContext()
 {
     clplatform = cl::Platform::getDefault();
-    clplatform.getDevices(CL_DEVICE_TYPE_GPU, &cldevices);
+    clplatform.getDevices(CL_DEVICE_TYPE_ALL, &cldevices);
+
+    // Prefer a GPU if there is one.
+    std::stable_partition(cldevices.begin(), cldevices.end(), [](const cl::Device& dev) {
+        return dev.getInfo<CL_DEVICE_TYPE>() & CL_DEVICE_TYPE_GPU;
+    });
+
+    auto& device = cldevices.front();
+    const auto units = device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>();
+    auto used = units;
+
+    if ((device.getInfo<CL_DEVICE_TYPE>() & CL_DEVICE_TYPE_CPU) && units > CL_RESERVED_CORES) {
+        // Split off a sub-device without the reserved cores.
+        const cl_device_partition_property props[] = {
+            CL_DEVICE_PARTITION_BY_COUNTS, static_cast<cl_device_partition_property>(units - CL_RESERVED_CORES),
+            CL_DEVICE_PARTITION_BY_COUNTS_LIST_END, 0
+        };
+
+        try {
+            std::vector<cl::Device> subdevices;
+            device.createSubDevices(props, &subdevices);
+            device = subdevices.front();
+            used = units - CL_RESERVED_CORES;
+        } catch (const cl::Error&) {
+            // Not every implementation supports fission; use the whole device.
+        }
+    }
 
-    return cl::Context(cldevices.front());
+    std::cout << "OpenCL device: " << device.getInfo<CL_DEVICE_NAME>() << " (" << used << " of " << units
+              << " compute units)" << std::endl;
+    return cl::Context(device);
 }
 
-cl::Program initCLProgram(cl::Context& clcontext, const char * const source)
+unsigned int clVectorWidth()
+{
+    // CPU implementations vectorize the scalar kernel inconsistently, so
+    // they get one that works on a vector of pixels instead.
+    const auto& device = cldevices.front();
+    if (!(device.getInfo<CL_DEVICE_TYPE>() & CL_DEVICE_TYPE_CPU))
+        return 1;
+
+#ifdef USE_DOUBLE
+    return device.getInfo<CL_DEVICE_PREFERRED_VECTOR_WIDTH_DOUBLE>() >= 8 ? 8 : 4;
+#else
+    // The fixed-point kernels only come in four lanes.
+    return 4;
+#endif
+}
+
+cl::Program initCLProgram(cl::Context& clcontext, const char * const source, unsigned int vectorWidth)
 {
     cl::Program *prog;
 
+    std::string options;
+#ifdef COUNT_ITERATIONS
+    options += " -DCOUNT_ITERATIONS";
+#endif
+    if (vectorWidth > 1)
+        options += " -DVECTOR_WIDTH=" + std::to_string(vectorWidth);
+
     try {
         prog = new cl::Program(clcontext, source);
-        prog->build();
+        prog->build(options.c_str());
         return *prog;
     } catch (const cl::Error& err) {
         const auto& dev = cldevices.front();
@@ -317,15 +778,66 @@ void initSDL(SDL_Window **window, SDL_Renderer **renderer, SDL_Texture **texture
     atexit(SDL_Quit);
 }
 
-void threadFpsMonitor(MandelbrotState& Mandelbrot)
+void threadFpsMonitor(MandelbrotState& Mandelbrot, WorkerPool& pool)
 {
+    auto batch = pool.stats(WorkerPool::Priority::Batch);
+    EnergyMeter energy;
+    double joules = energy.joules();
+    uint64_t iterations = Mandelbrot.iterations();
+
     while (!done) {
-        std::cout << "Rendered FPS: " << fps.load() << ", Z: " << (double)Mandelbrot.zoom() << std::endl;
-        fps.store(0);
+        const int frames = fps.exchange(0);
+        std::cout << "Rendered FPS: " << frames << ", Z: " << (double)Mandelbrot.zoom() << std::endl;
+
+        if (energy.available()) {
+            const auto nowJoules = energy.joules();
+            const auto nowIterations = Mandelbrot.iterations();
+            std::cout << "Power: " << nowJoules - joules << " W, ";
+            printEnergy(nowJoules - joules, frames, nowIterations - iterations);
+            std::cout << std::endl;
+            joules = nowJoules;
+            iterations = nowIterations;
+        }
+
+        // Batch work is reported on its own, so it isn't mistaken for interactive frames.
+        const auto now = pool.stats(WorkerPool::Priority::Batch);
+        if (now.tiles != batch.tiles)
+            std::cout << "Batch tiles/s: " << now.tiles - batch.tiles << " (" << now.seconds - batch.seconds << " worker-s)" << std::endl;
+        batch = now;
+
         std::this_thread::sleep_for(std::chrono::seconds(1));
     }
 }
 
+void printMemory()
+{
+    const auto& ledger = MemoryLedger::get();
+
+    std::cout << "Memory:";
+    for (unsigned int i = 0; i < static_cast<unsigned int>(MemoryUse::Count); ++i) {
+        const auto use = static_cast<MemoryUse>(i);
+        std::cout << ' ' << MemoryLedger::name(use) << ' ' << ledger.used(use) / (1024.0 * 1024.0) << " MiB,";
+    }
+
+    std::cout << " total " << ledger.total() / (1024.0 * 1024.0) << " MiB of ";
+    if (ledger.budget() != 0)
+        std::cout << ledger.budget() / (1024.0 * 1024.0) << " MiB" << std::endl;
+    else
+        std::cout << "unlimited" << std::endl;
+}
+
+void printEnergy(double joules, unsigned int frames, uint64_t iterations)
+{
+    if (frames != 0)
+        std::cout << joules / frames << " J/frame";
+    else
+        std::cout << "no frames";
+
+    // Iterations are only counted if COUNT_ITERATIONS is defined.
+    if (iterations != 0)
+        std::cout << ", " << joules / (iterations / 1e9) << " J/Giter";
+}
+
 void threadEventMonitor(MandelbrotState& Mandelbrot)
 {
     Float zfactor (1.03);
@@ -342,6 +854,8 @@ void threadEventMonitor(MandelbrotState& Mandelbrot)
                     done = true;
                 break;
             case SDL_MOUSEBUTTONDOWN:
+                Mandelbrot.setFocus(event.button.x, event.button.y);
+
                 // Calculate desired "normal" change from origin. -0.5 to 0.5.
                 // Zoom scales this result later.
                 newoffset = Complex {
@@ -362,6 +876,8 @@ void threadEventMonitor(MandelbrotState& Mandelbrot)
                 newoffset.imag = 0;
                 break;
             case SDL_MOUSEMOTION:
+                Mandelbrot.setFocus(event.motion.x, event.motion.y);
+
                 // Update offset on mouse movement, so zoom continues towards where the user expects.
                 if (zooming != Float(1)) {
                     newoffset.real += Float(event.motion.xrel / (double)WIN_DIM);
@@ -411,11 +927,35 @@ void threadEventMonitor(MandelbrotState& Mandelbrot)
     }
 }
 
-MandelbrotState::MandelbrotState():
-    m_calcing(false),
+MandelbrotState::MandelbrotState(WorkerPool& pool, WorkerPool::Priority priority):
+    m_state(FrameState::Idle),
     m_max_iterations(MIN_MAX_ITERATIONS),
-    m_zoom(MIN_ZOOM)
+    m_num_type(0),
+    m_calibration(CALIBRATION_FILE),
+    m_zoom(MIN_ZOOM),
+    m_focus_x(WIN_DIM / 2),
+    m_focus_y(WIN_DIM / 2),
+    m_iterations(0),
+    m_frame_arena(FRAME_ARENA_SIZE, MemoryUse::Frame, false, Arena::Pages::Small),
+    m_on_device(false),
+    m_pool(pool),
+    m_priority(priority)
 {
+    m_points = m_frame_arena.allocate<Complex>(WIN_DIM * WIN_DIM);
+    m_row = m_frame_arena.allocate<Float>(WIN_DIM);
+    m_col = m_frame_arena.allocate<Float>(WIN_DIM);
+    m_output = m_frame_arena.allocate<uint32_t>(WIN_DIM * WIN_DIM);
+    m_tile_exact = m_frame_arena.allocate<bool>(TILE_COUNT);
+    m_tile_dirty = m_frame_arena.allocate<bool>(TILE_COUNT);
+
+    try {
+        m_history_arena.emplace(HISTORY_ARENA_SIZE, MemoryUse::History, true, Arena::Pages::Small);
+        m_prev_output = m_history_arena->allocate<uint32_t>(WIN_DIM * WIN_DIM);
+        m_prev_tile_exact = m_history_arena->allocate<bool>(TILE_COUNT);
+    } catch (const std::bad_alloc&) {
+        // Over budget. Every frame will be calculated in full.
+    }
+
 #ifndef BENCHMARK
     // This is a good starting point.
     m_origin.real = -1;
@@ -425,100 +965,204 @@ MandelbrotState::MandelbrotState():
     m_origin.imag = 0;
 #endif
 
-    // Spawn calcThread to begin receiving recalculation requests.
-    m_recalc.clear();
-    m_calc_thread = std::thread([this] { calcThread(); });
+    // There is no previous frame yet, so nothing will be taken from it.
+    m_prev_zoom = m_zoom;
+    m_prev_origin = m_origin;
 }
 
 MandelbrotState::~MandelbrotState() {
-    // calcThread is likely waiting for m_recalc to become true.
-    m_recalc.test_and_set();
-    m_recalc.notify_all();
+    // Skip the rest of the frame in progress, and wait for it to wind down.
+    m_stop.request_stop();
+    m_state.wait(FrameState::Rendering);
 
-    // Bring calcThread in if it's still running.
-    if (m_calc_thread.joinable())
-        m_calc_thread.join();
+    // The frame may still be notifying; it is done once it releases the lock.
+    std::lock_guard lock (m_state_lock);
 }
 
 #ifndef NO_OPENCL
-void MandelbrotState::initKernel(cl::Context& clcontext, cl::Program& clprogram, const char *kernelname)
+void MandelbrotState::initKernel(cl::Context& clcontext, std::vector<cl::Program>& clprograms, const char *kernelname,
+                                 unsigned int vectorWidth)
+{
+    auto cl = std::make_unique<ClBackend>(clcontext, clprograms, kernelname, vectorWidth);
+
+    std::lock_guard lock (m_cl_lock);
+    m_cl_pending = std::move(cl);
+}
+
+MandelbrotState::ClBackend::ClBackend(cl::Context& clcontext, std::vector<cl::Program>& clprograms,
+                                      const char *kernelname, unsigned int vectorWidth):
+    queue(clcontext),
+    input(clcontext, CL_MEM_READ_ONLY, WIN_DIM * WIN_DIM * sizeof(Complex)),
+    output(clcontext, CL_MEM_WRITE_ONLY, WIN_DIM * WIN_DIM * sizeof(uint32_t)),
+    vectorWidth(vectorWidth)
 {
-    m_cl_kernel.reset(new cl::Kernel(clprogram, "mandelbrot_calc"));
-    m_cl_queue.reset(new cl::CommandQueue(clcontext));
-    m_cl_input.reset(new cl::Buffer(clcontext, CL_MEM_READ_ONLY, WIN_DIM * WIN_DIM * sizeof(Complex)));
-    m_cl_output.reset(new cl::Buffer(clcontext, CL_MEM_WRITE_ONLY, WIN_DIM * WIN_DIM * sizeof(uint32_t)));
+    MemoryLedger::get().reserve(MemoryUse::Device, CL_BUFFER_SIZE);
+
+#ifdef COUNT_ITERATIONS
+    iterations = cl::Buffer(clcontext, CL_MEM_READ_WRITE, sizeof(cl_uint));
+#endif
 
     // These kernel parameters do not change throughout execution.
     // Max iteration count does, and is set with each kernel execution.
-    m_cl_kernel->setArg(0, *m_cl_input);
-    m_cl_kernel->setArg(1, *m_cl_output);
+    for (auto& program : clprograms) {
+        auto& kernel = kernels.emplace_back(program, kernelname);
+        kernel.setArg(0, input);
+        kernel.setArg(1, output);
+#ifdef COUNT_ITERATIONS
+        kernel.setArg(3, iterations);
+#endif
+    }
+}
+
+MandelbrotState::ClBackend::~ClBackend() {
+    MemoryLedger::get().release(MemoryUse::Device, CL_BUFFER_SIZE);
 }
 #endif // NO_OPENCL
 
+const char *MandelbrotState::backendName() const {
+    return m_on_device ? "OpenCL" : CPU_BACKEND_NAME;
+}
+
+const char *MandelbrotState::numTypeName() const {
+#ifdef USE_PERTURBATION
+    if (m_perturb && !m_on_device)
+        return "perturbation";
+#endif
+    return NUM_TYPES[m_num_type].name;
+}
+
 Float MandelbrotState::zoom() const {
     return m_zoom;
 }
 
+uint64_t MandelbrotState::iterations() const {
+    return m_iterations;
+}
+
+void MandelbrotState::setFocus(int x, int y) {
+    m_focus_x = x;
+    m_focus_y = y;
+}
+
 bool MandelbrotState::moveOriginAndZoomBy(Complex c, Float z) {
-    if (!m_calcing) {
+    // Claim the next frame first, so a follow-up frame can't start in between.
+    auto idle = FrameState::Idle;
+
+    if (m_state.compare_exchange_strong(idle, FrameState::Rendering)) {
         m_origin.real += c.real;
         m_origin.imag += c.imag;
         m_zoom = std::min(MIN_ZOOM, m_zoom * z);
         m_max_iterations = std::max(MIN_MAX_ITERATIONS, calculateMaxIterations(m_zoom));
 
-        scheduleRecalculation();
+        startFrame();
+        return true;
+    } else {
+        return false;
     }
-
-    return !m_calcing;
 }
 
 bool MandelbrotState::intoTexture(SDL_Texture *texture) {
-    if (m_calcing) {
+    if (m_state != FrameState::Idle) {
         // Wait for the calculations to complete.
-        m_recalc.wait(true);
-
-        // Lock the SDL texture, then stream the OpenCL output into it.
-        void *dst;
-        int pitch;
-        SDL_LockTexture(texture, nullptr, &dst, &pitch);
-#ifdef NO_OPENCL
-        std::memcpy(dst, renderOutput.data(), renderOutput.size() * sizeof(uint32_t));
-#else
-        m_cl_queue->enqueueReadBuffer(*m_cl_output, CL_TRUE, 0, WIN_DIM * WIN_DIM * sizeof(uint32_t), dst);
+        m_state.wait(FrameState::Rendering);
+
+        if (m_on_device) {
+#ifndef NO_OPENCL
+            // Lock the SDL texture, then stream the OpenCL output into it.
+            void *dst;
+            int pitch;
+            SDL_LockTexture(texture, nullptr, &dst, &pitch);
+            m_cl->queue.enqueueReadBuffer(m_cl->output, CL_TRUE, 0, WIN_DIM * WIN_DIM * sizeof(uint32_t), dst);
+            SDL_UnlockTexture(texture);
 #endif
-        SDL_UnlockTexture(texture);
+        } else {
+            uploadDirtyTiles(texture);
+        }
 
-        std::chrono::duration<double> diff = 
-            std::chrono::high_resolution_clock::now() - clTime;
+        m_shown = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> diff = m_shown - m_calc_start;
         std::cout << "Time: " << diff.count() << "s" << std::endl;
 
+        m_exact = m_on_device || std::ranges::find(m_tile_exact, false) == m_tile_exact.end();
+
         // Allow user input to modify origin and zoom,
         // also allowing the next calculation to be scheduled.
-        m_calcing = false;
+        m_state = FrameState::Idle;
         return true;
     } else {
+        // Tiles that missed the deadline are finished by another frame of
+        // the same view, once user input has stopped asking for new ones.
+        if (!m_exact && std::chrono::high_resolution_clock::now() - m_shown >= FOLLOW_UP_DELAY)
+            scheduleRecalculation();
+
         return false;
     }
 }
 
-void MandelbrotState::scheduleRecalculation() {
-    if (!m_calcing) {
-        // Tell calcThread that it's time to recalculate.
-        m_recalc.test_and_set();
-        m_recalc.notify_one();
+void MandelbrotState::uploadDirtyTiles(SDL_Texture *texture)
+{
+    // Merge each run of changed tiles in a row of tiles into one rectangle.
+    for (unsigned int row = 0; row < TILES_PER_ROW; ++row) {
+        const auto dirty = m_tile_dirty.subspan(row * TILES_PER_ROW, TILES_PER_ROW);
+
+        for (auto first = dirty.begin(); (first = std::find(first, dirty.end(), true)) != dirty.end();) {
+            const auto last = std::find(first, dirty.end(), false);
+            const SDL_Rect rect {
+                static_cast<int>((first - dirty.begin()) * TILE_DIM), static_cast<int>(row * TILE_DIM),
+                static_cast<int>((last - first) * TILE_DIM), TILE_DIM
+            };
+
+            SDL_UpdateTexture(texture, &rect, &m_output[rect.y * WIN_DIM + rect.x], WIN_DIM * sizeof(uint32_t));
+            first = last;
+        }
     }
 }
 
-void MandelbrotState::calcThread() {
-    while (!done) {
-        // Wait for a recalculation to be requested, indicated by m_recalc becoming true.
-        m_recalc.wait(false);
-        calculateBitmap();
+void MandelbrotState::scheduleRecalculation() {
+    auto idle = FrameState::Idle;
+
+    if (m_state.compare_exchange_strong(idle, FrameState::Rendering))
+        startFrame();
+}
+
+bool MandelbrotState::exact() const {
+    return m_exact;
+}
 
-        // Finished. Clear m_recalc, and notify the render thread (checked at MandelbrotState::intoTexture).
-        m_recalc.clear();
-        m_recalc.notify_one();
+void MandelbrotState::startFrame()
+{
+    spawn(renderFrame(m_stop.get_token()), [this] {
+        // Finished. Notify the render thread (checked at MandelbrotState::intoTexture).
+        std::lock_guard lock (m_state_lock);
+        m_state = FrameState::Ready;
+        m_state.notify_all();
+    });
+}
+
+Task MandelbrotState::renderFrame(std::stop_token stop)
+{
+    // Leave the thread that scheduled us.
+    co_await schedule(m_pool, m_priority);
+
+#ifndef NO_OPENCL
+    // Switch over to OpenCL once it is ready.
+    if (!m_on_device) {
+        std::lock_guard lock (m_cl_lock);
+        if (m_cl_pending) {
+            m_cl = std::move(m_cl_pending);
+            m_on_device = true;
+        }
     }
+#endif
+
+    // Known only now, since the backend may have just changed.
+    m_num_type = numTypeFor(m_zoom);
+    preparePoints();
+
+    if (!stop.stop_requested())
+        co_await calculateBitmap(stop);
+
+    // Coloring is done by the kernel, and intoTexture() presents the result.
 }
 
 uint32_t MandelbrotState::calculateMaxIterations(Float zoom)
@@ -529,12 +1173,140 @@ uint32_t MandelbrotState::calculateMaxIterations(Float zoom)
     return MIN_MAX_ITERATIONS * (1.5 - std::log(static_cast<double>(zoom)) / std::log((double)MIN_ZOOM));
 }
 
-void MandelbrotState::calculateBitmap()
+unsigned int MandelbrotState::numTypeFor(Float zoom) const
+{
+    if (const auto name = m_calibration.lookup(m_on_device ? "opencl" : "cpu", zoomDepth(zoom))) {
+        for (unsigned int i = 0; i < NUM_TYPE_COUNT; ++i) {
+            if (*name == NUM_TYPES[i].name)
+                return i;
+        }
+    }
+
+    return preciseTypeFor(zoom);
+}
+
+unsigned int MandelbrotState::preciseTypeFor(Float zoom, int margin)
+{
+    // The last type is the most precise, and used regardless.
+    for (unsigned int i = 0; i + 1 < NUM_TYPE_COUNT; ++i) {
+        if (zoom >= Float(std::ldexp(WIN_DIM, margin - NUM_TYPES[i].fractionBits)))
+            return i;
+    }
+
+    return NUM_TYPE_COUNT - 1;
+}
+
+int MandelbrotState::zoomDepth(Float zoom)
+{
+    // Compared as Floats, since deep zooms are past what a double converts to.
+    int depth = 0;
+    while (zoom < Float(std::ldexp(1.0, -depth)) && depth < 1024)
+        ++depth;
+
+    return depth;
+}
+
+double MandelbrotState::timeNumType(unsigned int type, const Complex *points, uint32_t *output, unsigned int count,
+                                    uint32_t maxIterations)
 {
-    static std::array<Complex, WIN_DIM * WIN_DIM> points;
-    static std::array<Float, WIN_DIM> row;
-    static std::array<Float, WIN_DIM> col;
+    const auto start = std::chrono::high_resolution_clock::now();
+
+#ifndef NO_OPENCL
+    if (m_on_device) {
+        auto& kernel = m_cl->kernels[type];
+        kernel.setArg(2, maxIterations);
+        m_cl->queue.enqueueWriteBuffer(m_cl->input, CL_TRUE, 0, count * sizeof(Complex), points);
+        m_cl->queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(count / m_cl->vectorWidth), cl::NullRange);
+        m_cl->queue.enqueueReadBuffer(m_cl->output, CL_TRUE, 0, count * sizeof(uint32_t), output);
+    } else
+#endif
+    {
+        NUM_TYPES[type].calculate(reinterpret_cast<const KernelPoint *>(points), output, maxIterations, 0, count);
+    }
+
+    std::chrono::duration<double> seconds = std::chrono::high_resolution_clock::now() - start;
+    return seconds.count();
+}
+
+void MandelbrotState::calibrate()
+{
+    constexpr unsigned int count = CALIBRATION_DIM * CALIBRATION_DIM;
+    // Beyond this, even the most precise type has too few bits left.
+    const int maxDepth = NUM_TYPES[NUM_TYPE_COUNT - 1].fractionBits - PRECISION_MARGIN;
+
+    std::vector<Complex> points (count);
+    std::vector<uint32_t> reference (count);
+    std::vector<uint32_t> output (count);
+
+    for (bool device : {false, true}) {
+#ifndef NO_OPENCL
+        if (device && !m_cl) {
+            std::lock_guard lock (m_cl_lock);
+            m_cl = std::move(m_cl_pending);
+        }
+        if (device && !m_cl)
+            break;
+#else
+        if (device)
+            break;
+#endif
+        m_on_device = device;
+        const char *backend = device ? "opencl" : "cpu";
+
+        for (int depth = 0; depth <= maxDepth; depth += CALIBRATION_STEP) {
+            // The view is the middle of a frame at this depth, in Seahorse
+            // Valley, which has detail to about depth 45.
+            const Float zoom (std::ldexp(1.0, -depth));
+            const Float step (zoom * Float(1.0 / WIN_DIM));
+            for (unsigned int j = 0; j < CALIBRATION_DIM; ++j) {
+                for (unsigned int i = 0; i < CALIBRATION_DIM; ++i) {
+                    auto& c = points[j * CALIBRATION_DIM + i];
+                    c.real = Float(-0.743643887037151) + step * Float(static_cast<double>(i) - CALIBRATION_DIM / 2);
+                    c.imag = Float(0.131825904205330) + step * Float(static_cast<double>(j) - CALIBRATION_DIM / 2);
+                }
+            }
 
+            // Each type is timed twice, to leave out the first run's warm-up.
+            const auto maxIterations = std::max(MIN_MAX_ITERATIONS, calculateMaxIterations(zoom));
+            const auto time = [&](unsigned int type, std::vector<uint32_t>& out) {
+                return std::min(timeNumType(type, points.data(), out.data(), count, maxIterations),
+                                timeNumType(type, points.data(), out.data(), count, maxIterations));
+            };
+
+            unsigned int best = NUM_TYPE_COUNT - 1;
+            double bestTime = time(best, reference);
+
+            // Cheaper types than PRECISION_MARGIN allows are tried too, down
+            // to those that can still tell the pixels apart. Past the detail of
+            // this view they could not be told from the others, so there,
+            // only types with the full margin are tried.
+            const auto center = std::ranges::count(reference, reference[count / 2]);
+            const bool detailed = center < count * (1 - 2 * CALIBRATION_TOLERANCE);
+            for (unsigned int type = preciseTypeFor(zoom, detailed ? 0 : PRECISION_MARGIN); type + 1 < NUM_TYPE_COUNT;
+                 ++type) {
+                const double seconds = time(type, output);
+                const auto wrong = std::inner_product(output.begin(), output.end(), reference.begin(), 0u,
+                                                      std::plus {}, std::not_equal_to {});
+
+                if (wrong <= count * CALIBRATION_TOLERANCE && seconds < bestTime) {
+                    best = type;
+                    bestTime = seconds;
+                }
+            }
+
+            m_calibration.record(backend, depth, NUM_TYPES[best].name);
+            std::cout << "Calibrated " << backend << " at depth " << depth << ": " << NUM_TYPES[best].name
+                      << " (" << bestTime * 1e3 << "ms)" << std::endl;
+        }
+    }
+
+    m_on_device = false;
+    m_calibration.save();
+    std::cout << "Saved calibration to " << CALIBRATION_FILE << std::endl;
+}
+
+void MandelbrotState::preparePoints()
+{
     //
     // Generate a list of every Complex coordinate that needs to be calculated.
 
@@ -544,7 +1316,7 @@ void MandelbrotState::calculateBitmap()
     pt.imag = m_origin.imag - m_zoom * Float(0.5);
 
     {
-        auto p = row.begin();
+        auto p = m_row.begin();
         Float r = pt.real;
         for (int i = 0; i < WIN_DIM; ++i) {
             *p++ = r;
@@ -553,7 +1325,7 @@ void MandelbrotState::calculateBitmap()
     }
 
     {
-        auto p = col.begin();
+        auto p = m_col.begin();
         Float r = pt.imag;
         for (int i = 0; i < WIN_DIM; ++i) {
             *p++ = r;
@@ -561,43 +1333,492 @@ void MandelbrotState::calculateBitmap()
         }
     }
 
-    auto ptr = points.begin();
-    for (int j = 0; j < WIN_DIM; ++j) {
-        Complex c;
-        c.imag = col[j];
+    // The CPU fills in points as it goes, tile by tile.
+    if (m_on_device) {
+        auto ptr = m_points.begin();
+        for (int j = 0; j < WIN_DIM; ++j) {
+            Complex c;
+            c.imag = m_col[j];
 
-        for (int i = 0; i < WIN_DIM; ++i) {
-            c.real = row[i];
-            *ptr++ = c;
+            for (int i = 0; i < WIN_DIM; ++i) {
+                c.real = m_row[i];
+                *ptr++ = c;
+            }
         }
     }
+}
 
+Task MandelbrotState::calculateBitmap([[maybe_unused]] std::stop_token stop)
+{
     //
     // Pass the list into the OpenCL kernel, and begin execution.
 
-    while (m_calcing)
-        std::this_thread::yield();
+    m_calc_start = std::chrono::high_resolution_clock::now();
+#ifndef NO_OPENCL
+    if (m_on_device) {
+        auto& kernel = m_cl->kernels[m_num_type];
+        kernel.setArg(2, m_max_iterations);
+        m_cl->queue.enqueueWriteBuffer(m_cl->input, CL_TRUE, 0, m_points.size_bytes(), m_points.data());
+#ifdef COUNT_ITERATIONS
+        // The count is 32-bit, which holds a frame's worth of iterations.
+        cl_uint count = 0;
+        m_cl->queue.enqueueWriteBuffer(m_cl->iterations, CL_FALSE, 0, sizeof(count), &count);
+#endif
+        m_cl->queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(m_points.size() / m_cl->vectorWidth), cl::NullRange);
+#ifdef COUNT_ITERATIONS
+        m_cl->queue.enqueueReadBuffer(m_cl->iterations, CL_FALSE, 0, sizeof(count), &count);
+#endif
+        m_cl->queue.finish();
+#ifdef COUNT_ITERATIONS
+        m_iterations += count;
+#endif
+        co_return;
+    }
+#endif
+
+#ifdef USE_PERTURBATION
+    m_perturb = preciseTypeFor(m_zoom) > 0;
+    if (m_perturb)
+        calculateReference();
+    [[maybe_unused]] const bool runsKernel = !m_perturb;
+#else
+    [[maybe_unused]] const bool runsKernel = true;
+#endif
+#ifdef USE_JIT
+    // Perturbation runs no kernel, so none is compiled for it.
+    m_jit_kernel = runsKernel ? m_jit.get(NUM_TYPES[m_num_type].cpuKernel) : nullptr;
+#endif
+
+#ifdef USE_STD_EXECUTION
+    // calculateTile() takes no locks and allocates nothing, so tiles may be
+    // run interleaved or vectorized as the library sees fit. Their iteration
+    // counts are summed by the library too, rather than in the atomic.
+    m_iterations += std::transform_reduce(std::execution::par_unseq, TILE_INDICES.begin(), TILE_INDICES.end(),
+                                          uint64_t(0), std::plus<>{},
+                                          [this](unsigned int tile) { return calculateTile(tile); });
+    std::fill(m_tile_exact.begin(), m_tile_exact.end(), true);
+    std::fill(m_tile_dirty.begin(), m_tile_dirty.end(), true);
+#else
+    // Without the previous frame, there is nothing to reuse.
+    const bool history = !m_prev_output.empty();
+    if (history) {
+        std::swap(m_output, m_prev_output);
+        std::swap(m_tile_exact, m_prev_tile_exact);
+    }
+
+    // Tiles that the previous frame finished can be copied if the view hasn't changed.
+    const bool sameView = history && m_zoom == m_prev_zoom && m_origin.real == m_prev_origin.real &&
+                          m_origin.imag == m_prev_origin.imag;
+    const double scale = static_cast<double>(m_zoom) / static_cast<double>(m_prev_zoom);
+    const double dx = static_cast<double>(m_origin.real - m_prev_origin.real) / static_cast<double>(m_prev_zoom);
+    const double dy = static_cast<double>(m_origin.imag - m_prev_origin.imag) / static_cast<double>(m_prev_zoom);
+    const auto deadline = m_calc_start + FRAME_BUDGET;
+    // The first tile to find the deadline passed is calculated anyway, so the
+    // follow-up frames of a still view always make progress.
+    std::atomic_flag progressed;
+
+    m_prev_zoom = m_zoom;
+    m_prev_origin = m_origin;
+
+    // Rank tiles by their distance from the focus, so the region the user is
+    // looking at appears first. If the frame is cancelled or runs out of time,
+    // the periphery may never be calculated at all.
+    const int fx = m_focus_x / TILE_DIM;
+    const int fy = m_focus_y / TILE_DIM;
+    const auto distance = [fx, fy](unsigned int tile) {
+        const int dx = static_cast<int>(tile % TILES_PER_ROW) - fx;
+        const int dy = static_cast<int>(tile / TILES_PER_ROW) - fy;
+        return static_cast<unsigned int>(dx * dx + dy * dy);
+    };
+
+    // Tiles fill in their own points, so that the worker writing a tile's
+    // results is also the first to touch its part of m_points.
+    const auto tileFunc = [=, this, &progressed](unsigned int tile, [[maybe_unused]] unsigned int worker) {
+        if (sameView && m_prev_tile_exact[tile]) {
+            // Already on screen, so the texture doesn't need it either.
+            reprojectTile(tile, 1, 0, 0);
+            m_tile_exact[tile] = true;
+            m_tile_dirty[tile] = false;
+        } else if (history && FRAME_BUDGET.count() != 0 && std::chrono::high_resolution_clock::now() >= deadline &&
+                   progressed.test_and_set()) {
+            // Out of time. This tile will be finished by the next frame if the view stays put.
+            reprojectTile(tile, scale, dx, dy);
+            m_tile_exact[tile] = false;
+            m_tile_dirty[tile] = true;
+        } else if (history && scale >= 1) {
+            // Most of a zoomed out frame is the last frame, shrunk.
+            m_iterations += zoomOutTile(tile, scale, dx, dy);
+            m_tile_exact[tile] = true;
+            m_tile_dirty[tile] = true;
+        } else {
+#if defined(USE_BOUNDARY_TRACING)
+            m_iterations += traceTile(tile, m_pool.scratch(worker));
+#elif defined(USE_INTERPOLATION)
+            m_iterations += interpolateTile(tile, m_pool.scratch(worker));
+#else
+            m_iterations += calculateTile(tile);
+#endif
+            m_tile_exact[tile] = true;
+            m_tile_dirty[tile] = true;
+        }
+    };
+
+    co_await forEachTile(m_pool, TILE_COUNT, tileFunc, stop, m_priority, distance);
+#endif
 
-    m_calcing = true;
+    co_return;
+}
 
-    clTime = std::chrono::high_resolution_clock::now();
-#ifdef NO_OPENCL
-    std::vector<std::thread> execs;
+uint64_t MandelbrotState::calculateRange(unsigned int begin, unsigned int end)
+{
+    const auto points = reinterpret_cast<const KernelPoint *>(m_points.data());
+
+#ifdef USE_PERTURBATION
+    if (m_perturb)
+        return perturbRange(begin, end);
+#endif
+#ifdef USE_JIT
+    if (m_jit_kernel)
+        return m_jit_kernel(points, m_output.data(), m_max_iterations, begin, end);
+#endif
+    return NUM_TYPES[m_num_type].calculate(points, m_output.data(), m_max_iterations, begin, end);
+}
 
-    for (int t = 0; t < THREAD_COUNT; ++t) {
-        execs.emplace_back([this, t] {
-            for (size_t i = t * renderOutput.size() / THREAD_COUNT; i < (t + 1) * renderOutput.size() / THREAD_COUNT; ++i) {
-                globalIds.insert_or_assign(std::this_thread::get_id(), i);
-                mandelbrot_calc((CALC_SRC_T *)points.data(), renderOutput.data(), m_max_iterations);
-            }});
+#ifdef USE_PERTURBATION
+void MandelbrotState::calculateReference()
+{
+    Complex z;
+    m_orbit.assign(1, 0);
+
+    // Stops right after escaping, while still in the range of Float.
+    while (m_orbit.size() <= m_max_iterations && std::norm(m_orbit.back()) < 4) {
+        const Float xy = z.real * z.imag;
+        z = Complex {z.real * z.real - z.imag * z.imag + m_origin.real, xy + xy + m_origin.imag};
+        m_orbit.emplace_back(static_cast<double>(z.real), static_cast<double>(z.imag));
     }
+}
 
-    for (auto& t : execs)
-        t.join();
+uint64_t MandelbrotState::perturbRange(unsigned int begin, unsigned int end)
+{
+    const unsigned int last = m_orbit.size() - 1;
+    uint64_t total = 0;
+
+    for (unsigned int i = begin; i < end; ++i) {
+        // Offsets are tiny, so they keep their precision as doubles.
+        const double dcx = static_cast<double>(m_points[i].real - m_origin.real);
+        const double dcy = static_cast<double>(m_points[i].imag - m_origin.imag);
+        double dx = 0, dy = 0;
+        unsigned int m = 0; // Where the pixel is along the reference orbit.
+        unsigned int iterations = 0;
+
+        while (iterations < m_max_iterations) {
+            // z + Z' = (z + Z)^2 + c + C, so z' = (2Z + z)z + c.
+            const double ax = 2 * m_orbit[m].real() + dx;
+            const double ay = 2 * m_orbit[m].imag() + dy;
+            const double nx = ax * dx - ay * dy + dcx;
+            dy = ax * dy + ay * dx + dcy;
+            dx = nx;
+            ++m;
+
+            const double x = m_orbit[m].real() + dx;
+            const double y = m_orbit[m].imag() + dy;
+            if (x * x + y * y >= 4)
+                break;
+
+            ++iterations;
+
+            // Rebase onto the start of the orbit once the pixel is nearer to
+            // zero than to the reference, where its offset would lose
+            // precision, or once the reference runs out.
+            if (x * x + y * y < dx * dx + dy * dy || m == last) {
+                dx = x;
+                dy = y;
+                m = 0;
+            }
+        }
+
+        total += iterations;
+        if (iterations == m_max_iterations)
+            m_output[i] = 0;
+        else
+            m_output[i] = ((iterations & 0xFF) << 16) | ((iterations & 0x07) << 6);
+    }
+
+#ifdef COUNT_ITERATIONS
+    return total;
 #else
-    m_cl_kernel->setArg(2, m_max_iterations);
-    m_cl_queue->enqueueWriteBuffer(*m_cl_input, CL_TRUE, 0, points.size() * sizeof(Complex), points.data());
-    m_cl_queue->enqueueNDRangeKernel(*m_cl_kernel, cl::NullRange, cl::NDRange(points.size()), cl::NullRange);
+    return 0;
 #endif
 }
+#endif
+
+uint64_t MandelbrotState::calculateTile(unsigned int tile)
+{
+    const unsigned int x0 = tile % TILES_PER_ROW * TILE_DIM;
+    const unsigned int y0 = tile / TILES_PER_ROW * TILE_DIM;
+    uint64_t iterations = 0;
+
+    for (unsigned int y = y0; y < y0 + TILE_DIM; ++y) {
+        const unsigned int begin = y * WIN_DIM + x0;
+
+        for (unsigned int x = 0; x < TILE_DIM; ++x)
+            m_points[begin + x] = Complex {m_row[x0 + x], m_col[y]};
+
+        iterations += calculateRange(begin, begin + TILE_DIM);
+    }
+
+    return iterations;
+}
+
+uint64_t MandelbrotState::traceTile(unsigned int tile, Arena& scratch)
+{
+    const unsigned int x0 = tile % TILES_PER_ROW * TILE_DIM;
+    const unsigned int y0 = tile / TILES_PER_ROW * TILE_DIM;
+    uint64_t iterations = 0;
+
+    // Pixels are indexed within the tile. Each is queued at most once, so the
+    // queue never wraps around.
+    constexpr uint8_t QUEUED = 1, DONE = 2;
+    const auto state = scratch.allocate<uint8_t>(TILE_DIM * TILE_DIM);
+    const auto queue = scratch.allocate<uint16_t>(TILE_DIM * TILE_DIM);
+    unsigned int head = 0, tail = 0;
+    std::fill(state.begin(), state.end(), 0);
+
+    const auto color = [&](unsigned int p) {
+        const unsigned int x = x0 + p % TILE_DIM;
+        const unsigned int y = y0 + p / TILE_DIM;
+        const unsigned int i = y * WIN_DIM + x;
+
+        if (!(state[p] & DONE)) {
+            m_points[i] = Complex {m_row[x], m_col[y]};
+            iterations += calculateRange(i, i + 1);
+            state[p] |= DONE;
+        }
+
+        return m_output[i];
+    };
+    const auto enqueue = [&](unsigned int p) {
+        if (!(state[p] & QUEUED)) {
+            state[p] |= QUEUED;
+            queue[tail++] = p;
+        }
+    };
+
+    // Regions may run off the tile, so its border is always calculated.
+    for (unsigned int k = 0; k < TILE_DIM; ++k) {
+        enqueue(k);
+        enqueue((TILE_DIM - 1) * TILE_DIM + k);
+        enqueue(k * TILE_DIM);
+        enqueue(k * TILE_DIM + TILE_DIM - 1);
+    }
+
+    // Wherever a pixel differs from a neighbor, the edge of a region runs
+    // between them, so it is followed onto the pixels around them.
+    while (head < tail) {
+        const unsigned int p = queue[head++];
+        const unsigned int x = p % TILE_DIM;
+        const unsigned int y = p / TILE_DIM;
+        const uint32_t c = color(p);
+
+        const bool left = x > 0 && color(p - 1) != c;
+        const bool right = x < TILE_DIM - 1 && color(p + 1) != c;
+        const bool up = y > 0 && color(p - TILE_DIM) != c;
+        const bool down = y < TILE_DIM - 1 && color(p + TILE_DIM) != c;
+
+        if (left)
+            enqueue(p - 1);
+        if (right)
+            enqueue(p + 1);
+        if (up)
+            enqueue(p - TILE_DIM);
+        if (down)
+            enqueue(p + TILE_DIM);
+        if (x > 0 && y > 0 && (left || up))
+            enqueue(p - TILE_DIM - 1);
+        if (x < TILE_DIM - 1 && y > 0 && (right || up))
+            enqueue(p - TILE_DIM + 1);
+        if (x > 0 && y < TILE_DIM - 1 && (left || down))
+            enqueue(p + TILE_DIM - 1);
+        if (x < TILE_DIM - 1 && y < TILE_DIM - 1 && (right || down))
+            enqueue(p + TILE_DIM + 1);
+    }
+
+    // Everything not calculated is enclosed by edges of one color, so takes
+    // the color to its left. The tile's left column is always calculated.
+    for (unsigned int y = 0; y < TILE_DIM; ++y) {
+        const unsigned int row = (y0 + y) * WIN_DIM + x0;
+
+        for (unsigned int x = 1; x < TILE_DIM; ++x) {
+            if (!(state[y * TILE_DIM + x] & DONE))
+                m_output[row + x] = m_output[row + x - 1];
+        }
+    }
+
+    return iterations;
+}
+
+uint64_t MandelbrotState::interpolateTile(unsigned int tile, Arena& scratch)
+{
+    const unsigned int x0 = tile % TILES_PER_ROW * TILE_DIM;
+    const unsigned int y0 = tile / TILES_PER_ROW * TILE_DIM;
+    uint64_t iterations = 0;
+
+    // Pixels are indexed within the tile.
+    const auto done = scratch.allocate<bool>(TILE_DIM * TILE_DIM);
+    std::fill(done.begin(), done.end(), false);
+
+    const auto color = [&](unsigned int x, unsigned int y) {
+        const unsigned int i = (y0 + y) * WIN_DIM + x0 + x;
+
+        if (!done[y * TILE_DIM + x]) {
+            m_points[i] = Complex {m_row[x0 + x], m_col[y0 + y]};
+            iterations += calculateRange(i, i + 1);
+            done[y * TILE_DIM + x] = true;
+        }
+
+        return m_output[i];
+    };
+    // Calculates the pixels from x to xLast in row y, in as few runs as possible.
+    const auto colorRow = [&](unsigned int x, unsigned int xLast, unsigned int y) {
+        for (; x <= xLast; ++x) {
+            const unsigned int begin = (y0 + y) * WIN_DIM + x0 + x;
+            unsigned int end = begin;
+            for (; x <= xLast && !done[y * TILE_DIM + x]; ++x, ++end) {
+                m_points[end] = Complex {m_row[x0 + x], m_col[y0 + y]};
+                done[y * TILE_DIM + x] = true;
+            }
+
+            if (end != begin)
+                iterations += calculateRange(begin, end);
+        }
+    };
+
+    // Colors keep the low byte of the iteration count, and are zero inside the set.
+    const auto countOf = [](uint32_t c) { return static_cast<int>(c >> 16 & 0xFF); };
+    const auto colorOf = [](int it) { return static_cast<uint32_t>(((it & 0xFF) << 16) | ((it & 0x07) << 6)); };
+
+    // Seeded by tile, so a frame always checks the same pixels.
+    std::minstd_rand random (tile + 1);
+
+    for (unsigned int by = 0; by < TILE_DIM; by += INTERPOLATION_BLOCK) {
+        for (unsigned int bx = 0; bx < TILE_DIM; bx += INTERPOLATION_BLOCK) {
+            // Blocks share their corners; the last ones end at the tile's edge.
+            const unsigned int x1 = std::min(bx + INTERPOLATION_BLOCK, TILE_DIM - 1);
+            const unsigned int y1 = std::min(by + INTERPOLATION_BLOCK, TILE_DIM - 1);
+            const std::array corners {color(bx, by), color(x1, by), color(bx, y1), color(x1, y1)};
+
+            // Blocks touching the set are calculated, as the set's edge can't
+            // be interpolated. A spread of half the color cycle or more is
+            // taken to be a wraparound.
+            const auto [low, high] = std::ranges::minmax(corners | std::views::transform(countOf));
+            bool smooth = std::ranges::count(corners, 0u) == 0 && high - low < 128;
+
+            // Bilinear in the corners' counts. This runs for most pixels, so
+            // it avoids std::lerp and divisions.
+            const double c00 = countOf(corners[0]), c10 = countOf(corners[1]);
+            const double c01 = countOf(corners[2]), c11 = countOf(corners[3]);
+            const double sx = 1.0 / (x1 - bx), sy = 1.0 / (y1 - by);
+            const auto predict = [&](unsigned int x, unsigned int y) {
+                const double fx = (x - bx) * sx;
+                const double top = c00 + (c10 - c00) * fx;
+                const double bottom = c01 + (c11 - c01) * fx;
+                return colorOf(static_cast<int>(top + (bottom - top) * ((y - by) * sy) + 0.5));
+            };
+
+            const auto fits = [&](unsigned int x, unsigned int y) {
+                const uint32_t actual = color(x, y);
+                return actual != 0 && std::abs(countOf(actual) - countOf(predict(x, y))) <= INTERPOLATION_TOLERANCE;
+            };
+
+            // The whole border is checked, so no band of color or part of
+            // the set can cross the block unseen; then a few pixels inside.
+            if (smooth) {
+                colorRow(bx, x1, by);
+                colorRow(bx, x1, y1);
+            }
+            for (unsigned int x = bx + 1; smooth && x < x1; ++x)
+                smooth = fits(x, by) && fits(x, y1);
+            for (unsigned int y = by + 1; smooth && y < y1; ++y)
+                smooth = fits(bx, y) && fits(x1, y);
+            for (unsigned int n = 0; smooth && n < INTERPOLATION_SAMPLES; ++n)
+                smooth = fits(bx + 1 + random() % (x1 - bx - 1), by + 1 + random() % (y1 - by - 1));
+
+            for (unsigned int y = by; y <= y1; ++y) {
+                if (!smooth) {
+                    colorRow(bx, x1, y);
+                    continue;
+                }
+
+                for (unsigned int x = bx; x <= x1; ++x) {
+                    if (!done[y * TILE_DIM + x])
+                        m_output[(y0 + y) * WIN_DIM + x0 + x] = predict(x, y);
+                }
+            }
+        }
+    }
+
+    return iterations;
+}
+
+void MandelbrotState::reprojectTile(unsigned int tile, double scale, double dx, double dy)
+{
+    const unsigned int x0 = tile % TILES_PER_ROW * TILE_DIM;
+    const unsigned int y0 = tile / TILES_PER_ROW * TILE_DIM;
+
+    // Pixels are placed in the view relative to its center, from -0.5 to 0.5.
+    const auto toPrevious = [scale](unsigned int p, double d) {
+        const double prev = ((p / (double)WIN_DIM - 0.5) * scale + d + 0.5) * WIN_DIM;
+        return std::clamp(static_cast<int>(std::lround(prev)), 0, WIN_DIM - 1);
+    };
+
+    for (unsigned int y = y0; y < y0 + TILE_DIM; ++y) {
+        const int py = toPrevious(y, dy);
 
+        for (unsigned int x = x0; x < x0 + TILE_DIM; ++x)
+            m_output[y * WIN_DIM + x] = m_prev_output[py * WIN_DIM + toPrevious(x, dx)];
+    }
+}
+
+uint64_t MandelbrotState::zoomOutTile(unsigned int tile, double scale, double dx, double dy)
+{
+    const unsigned int x0 = tile % TILES_PER_ROW * TILE_DIM;
+    const unsigned int y0 = tile / TILES_PER_ROW * TILE_DIM;
+    uint64_t iterations = 0;
+
+    const auto toPrevious = [scale](unsigned int p, double d) {
+        return static_cast<int>(std::lround(((p / (double)WIN_DIM - 0.5) * scale + d + 0.5) * WIN_DIM));
+    };
+    const auto exactAt = [this](int x, int y) {
+        return m_prev_tile_exact[y / TILE_DIM * TILES_PER_ROW + x / TILE_DIM];
+    };
+
+    for (unsigned int y = y0; y < y0 + TILE_DIM; ++y) {
+        const int py = toPrevious(y, dy);
+
+        for (unsigned int x = x0; x < x0 + TILE_DIM; ++x) {
+            const int px = toPrevious(x, dx);
+            const unsigned int i = y * WIN_DIM + x;
+
+            // The previous frame only sampled points, so a pixel landing
+            // between its samples is only known if all of them agree.
+            bool known = px > 0 && px < WIN_DIM - 1 && py > 0 && py < WIN_DIM - 1 &&
+                         exactAt(px - 1, py - 1) && exactAt(px + 1, py - 1) &&
+                         exactAt(px - 1, py + 1) && exactAt(px + 1, py + 1);
+
+            const uint32_t value = known ? m_prev_output[py * WIN_DIM + px] : 0;
+            for (int j = py - 1; known && j <= py + 1; ++j) {
+                for (int k = px - 1; known && k <= px + 1; ++k)
+                    known = m_prev_output[j * WIN_DIM + k] == value;
+            }
+
+            if (known) {
+                m_output[i] = value;
+            } else {
+                m_points[i] = Complex {m_row[x], m_col[y]};
+                iterations += calculateRange(i, i + 1);
+            }
+        }
+    }
+
+    return iterations;
+}
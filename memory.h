@@ -0,0 +1,122 @@
+/**
+ * happy-fractal - A study of efficient and precise fractal rendering.
+ * Copyright (C) 2022  Clyne Sullivan
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef HAPPY_FRACTAL_MEMORY_H
+#define HAPPY_FRACTAL_MEMORY_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// What a block of memory is used for.
+enum class MemoryUse {
+    Frame,   // Buffers needed to render a frame.
+    History, // Previous frames kept for reuse. Optional.
+    Scratch, // Per-worker scratch space.
+    Device,  // OpenCL buffers.
+    Count
+};
+
+/**
+ * Keeps a tally of the program's large allocations, by use, against a global
+ * budget. Required memory is always granted, though it counts towards the
+ * budget; optional memory is refused once the budget would be exceeded, so
+ * its owner can do without it.
+ */
+class MemoryLedger
+{
+public:
+    static MemoryLedger& get();
+
+    // Sets the budget in bytes. Zero means unlimited.
+    void setBudget(std::size_t bytes);
+    std::size_t budget() const;
+
+    // Records an allocation. Returns false, recording nothing, if the
+    // allocation is optional and does not fit in the budget.
+    bool reserve(MemoryUse use, std::size_t bytes, bool optional = false);
+    void release(MemoryUse use, std::size_t bytes);
+
+    std::size_t used(MemoryUse use) const;
+    std::size_t total() const;
+
+    static const char *name(MemoryUse use);
+
+private:
+    std::atomic_size_t m_budget {0};
+    std::atomic_size_t m_total {0};
+    std::array<std::atomic_size_t, static_cast<std::size_t>(MemoryUse::Count)> m_used {};
+
+    MemoryLedger() = default;
+};
+
+inline MemoryLedger& MemoryLedger::get() {
+    static MemoryLedger ledger;
+    return ledger;
+}
+
+inline void MemoryLedger::setBudget(std::size_t bytes) {
+    m_budget = bytes;
+}
+
+inline std::size_t MemoryLedger::budget() const {
+    return m_budget;
+}
+
+inline bool MemoryLedger::reserve(MemoryUse use, std::size_t bytes, bool optional)
+{
+    if (optional) {
+        auto total = m_total.load();
+        do {
+            if (m_budget != 0 && total + bytes > m_budget)
+                return false;
+        } while (!m_total.compare_exchange_weak(total, total + bytes));
+    } else {
+        m_total += bytes;
+    }
+
+    m_used[static_cast<std::size_t>(use)] += bytes;
+    return true;
+}
+
+inline void MemoryLedger::release(MemoryUse use, std::size_t bytes)
+{
+    m_used[static_cast<std::size_t>(use)] -= bytes;
+    m_total -= bytes;
+}
+
+inline std::size_t MemoryLedger::used(MemoryUse use) const {
+    return m_used[static_cast<std::size_t>(use)];
+}
+
+inline std::size_t MemoryLedger::total() const {
+    return m_total;
+}
+
+inline const char *MemoryLedger::name(MemoryUse use)
+{
+    switch (use) {
+    case MemoryUse::Frame:   return "frame";
+    case MemoryUse::History: return "history";
+    case MemoryUse::Scratch: return "scratch";
+    case MemoryUse::Device:  return "device";
+    default:                 return "?";
+    }
+}
+
+#endif // HAPPY_FRACTAL_MEMORY_H
@@ -1,35 +1,92 @@
-__kernel void mandelbrot_calc(const __global double2 *c_pt,
-                            __global unsigned int *out_it,
-                            const unsigned int max_iterations)
+// The Mandelbrot iteration, written once for every number type.
+// A num_*.c file must come first, to define point_t, num_t and the num_*()
+// operations (and numv_* for the vectorized kernel). The OpenCL source is
+// the two files put together; the CPU backend includes them both.
+
+__kernel void mandelbrot_calc(const __global point_t *c_pt,
+                              __global unsigned int *out_it,
+                              const unsigned int max_iterations
+#ifdef COUNT_ITERATIONS
+                              , __global unsigned int *iteration_count
+#endif
+                              )
 {
     const int id = get_global_id(0);
-    const double2 opt = c_pt[id];
-
-    double2 pt = opt;
-    double tmp = pt.x * pt.y;
-    unsigned int iterations = 0;
+    const num_t cx = num_re(c_pt[id]);
+    const num_t cy = num_im(c_pt[id]);
 
-    double q = (pt.x - 0.25) * (pt.x - 0.25) + pt.y * pt.y;
-    if (q * (q + (pt.x - 0.25)) <= 0.25 * pt.y * pt.y)
-        iterations = max_iterations;
+    num_t x = cx;
+    num_t y = cy;
+    unsigned int iterations = num_inside(cx, cy) ? max_iterations : 0;
 
     while (iterations < max_iterations) {
-        pt *= pt;
+        const num_t xy = num_mul(x, y);
+        const num_t xx = num_sqr(x);
+        const num_t yy = num_sqr(y);
 
-        if (pt.x + pt.y > 4.0)
+        if (!num_bounded(xx, yy))
             break;
 
-        pt.x = pt.x - pt.y;
-        pt.y = 2 * tmp;
-        pt += opt;
-        tmp = pt.x * pt.y;
+        x = num_add(num_sub(xx, yy), cx);
+        y = num_add(num_add(xy, xy), cy);
 
         ++iterations;
     }
 
+#ifdef COUNT_ITERATIONS
+    atomic_add(iteration_count, iterations);
+#endif
+
     if (iterations == max_iterations)
         out_it[id] = 0;
     else
         out_it[id] = ((iterations & 0xFF) << 16) | ((iterations & 0x07) << 6);
 }
 
+#if defined(__OPENCL_VERSION__) && defined(VECTOR_WIDTH)
+// Calculates VECTOR_WIDTH neighboring pixels per work-item, one in each lane.
+// Lanes that escape are masked off until every lane is done.
+__kernel void mandelbrot_calc_vec(const __global point_t *c_pt,
+                                  __global unsigned int *out_it,
+                                  const unsigned int max_iterations
+#ifdef COUNT_ITERATIONS
+                                  , __global unsigned int *iteration_count
+#endif
+                                  )
+{
+    const int id = get_global_id(0);
+    const numv_t cx = numv_load_re(c_pt, id);
+    const numv_t cy = numv_load_im(c_pt, id);
+
+    numv_t x = cx;
+    numv_t y = cy;
+    maskv_t active = ~numv_inside(cx, cy);
+    maskv_t iterations = select((maskv_t)(max_iterations), (maskv_t)(0), active);
+
+    for (unsigned int i = 0; i < max_iterations && any(active); ++i) {
+        const numv_t xy = numv_mul(x, y);
+        const numv_t xx = numv_sqr(x);
+        const numv_t yy = numv_sqr(y);
+
+        active &= numv_bounded(xx, yy);
+        iterations -= active; // Active lanes are all ones, i.e. -1.
+
+        x = numv_add(numv_sub(xx, yy), cx);
+        y = numv_add(numv_add(xy, xy), cy);
+    }
+
+    const uintv it = CONVERT_UINTV(iterations);
+    const uintv color = ((it & 0xFF) << 16) | ((it & 0x07) << 6);
+    VSTORE_UINTV(select(color, (uintv)(0), it == max_iterations), id, out_it);
+
+#ifdef COUNT_ITERATIONS
+    unsigned int lanes[VECTOR_WIDTH];
+    VSTORE_UINTV(it, 0, lanes);
+
+    unsigned int total = 0;
+    for (int i = 0; i < VECTOR_WIDTH; ++i)
+        total += lanes[i];
+    atomic_add(iteration_count, total);
+#endif
+}
+#endif // __OPENCL_VERSION__ && VECTOR_WIDTH
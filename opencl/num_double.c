@@ -0,0 +1,70 @@
+// Number operations in double precision, for opencl/mandelbrot_calc.c.
+
+typedef double2 point_t; // (real, imaginary)
+typedef double num_t;
+
+inline num_t num_re(const point_t p) { return p.x; }
+inline num_t num_im(const point_t p) { return p.y; }
+inline num_t num_add(const num_t a, const num_t b) { return a + b; }
+inline num_t num_sub(const num_t a, const num_t b) { return a - b; }
+inline num_t num_mul(const num_t a, const num_t b) { return a * b; }
+inline num_t num_sqr(const num_t a) { return a * a; }
+
+// True while a point with the given squares has not escaped, i.e. is within 2 of the origin.
+inline int num_bounded(const num_t xx, const num_t yy)
+{
+    return xx + yy <= 4.0;
+}
+
+// True if a point is known to be in the set without iterating: here, if it
+// is within the main cardioid.
+inline int num_inside(const num_t x, const num_t y)
+{
+    const num_t q = (x - 0.25) * (x - 0.25) + y * y;
+    return q * (q + (x - 0.25)) <= 0.25 * y * y;
+}
+
+#if defined(__OPENCL_VERSION__) && defined(VECTOR_WIDTH)
+#if VECTOR_WIDTH == 8
+typedef double8 numv_t;
+typedef long8 maskv_t;
+typedef uint8 uintv;
+#define VLOAD_POINTS vload16
+#define VSTORE_UINTV vstore8
+#define CONVERT_UINTV convert_uint8
+#else
+typedef double4 numv_t;
+typedef long4 maskv_t;
+typedef uint4 uintv;
+#define VLOAD_POINTS vload8
+#define VSTORE_UINTV vstore4
+#define CONVERT_UINTV convert_uint4
+#endif
+
+// The points are (x, y) pairs; split them into a vector of each.
+inline numv_t numv_load_re(const __global point_t *c_pt, int id)
+{
+    return VLOAD_POINTS(id, (const __global double *)c_pt).even;
+}
+
+inline numv_t numv_load_im(const __global point_t *c_pt, int id)
+{
+    return VLOAD_POINTS(id, (const __global double *)c_pt).odd;
+}
+
+inline numv_t numv_add(const numv_t a, const numv_t b) { return a + b; }
+inline numv_t numv_sub(const numv_t a, const numv_t b) { return a - b; }
+inline numv_t numv_mul(const numv_t a, const numv_t b) { return a * b; }
+inline numv_t numv_sqr(const numv_t a) { return a * a; }
+
+inline maskv_t numv_bounded(const numv_t xx, const numv_t yy)
+{
+    return xx + yy <= 4.0;
+}
+
+inline maskv_t numv_inside(const numv_t x, const numv_t y)
+{
+    const numv_t q = (x - 0.25) * (x - 0.25) + y * y;
+    return q * (q + (x - 0.25)) <= 0.25 * y * y;
+}
+#endif // __OPENCL_VERSION__ && VECTOR_WIDTH
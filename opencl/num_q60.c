@@ -0,0 +1,79 @@
+// Number operations in Q4.60 fixed-point, for opencl/mandelbrot_calc.c.
+// Each number is a single two's complement ulong. Points are given in Q4.124, as for
+// opencl/num_r128.c, and are truncated to their high halves.
+
+typedef ulong4 point_t; // (real, imaginary)
+typedef ulong num_t;
+
+// A product is 128 bits, of which bits 60 to 123 are kept.
+inline ulong q60Mul(const ulong a, const ulong b)
+{
+    return ((ulong)mul_hi((long)a, (long)b) << 4) | ((a * b) >> 60);
+}
+
+inline num_t num_re(const point_t p) { return p.lo.hi; }
+inline num_t num_im(const point_t p) { return p.hi.hi; }
+inline num_t num_add(const num_t a, const num_t b) { return a + b; }
+inline num_t num_sub(const num_t a, const num_t b) { return a - b; }
+inline num_t num_mul(const num_t a, const num_t b) { return q60Mul(a, b); }
+inline num_t num_sqr(const num_t a) { return q60Mul(a, a); }
+
+// True while a point with the given squares has not escaped, i.e. is within 2 of the origin.
+inline int num_bounded(const num_t xx, const num_t yy)
+{
+    return (long)(xx + yy) < 0x4000000000000000;
+}
+
+// True if a point is known to be in the set without iterating. No shortcut
+// is taken in fixed point.
+inline int num_inside(const num_t x, const num_t y)
+{
+    (void)x;
+    (void)y;
+    return 0;
+}
+
+#if defined(__OPENCL_VERSION__) && defined(VECTOR_WIDTH)
+#if VECTOR_WIDTH != 4
+#error "The fixed-point kernels only come in four lanes."
+#endif
+
+typedef ulong4 numv_t;
+typedef long4 maskv_t;
+typedef uint4 uintv;
+#define VSTORE_UINTV vstore4
+#define CONVERT_UINTV convert_uint4
+
+// Each point is (real.lo, real.hi, imag.lo, imag.hi).
+inline numv_t numv_load_re(const __global point_t *c_pt, int id)
+{
+    const ulong16 points = vload16(id, (const __global ulong *)c_pt);
+    return points.odd.even;
+}
+
+inline numv_t numv_load_im(const __global point_t *c_pt, int id)
+{
+    const ulong16 points = vload16(id, (const __global ulong *)c_pt);
+    return points.odd.odd;
+}
+
+inline numv_t numv_add(const numv_t a, const numv_t b) { return a + b; }
+inline numv_t numv_sub(const numv_t a, const numv_t b) { return a - b; }
+
+inline numv_t numv_mul(const numv_t a, const numv_t b)
+{
+    return (as_ulong4(mul_hi(as_long4(a), as_long4(b))) << 4) | ((a * b) >> 60);
+}
+
+inline numv_t numv_sqr(const numv_t a) { return numv_mul(a, a); }
+
+inline maskv_t numv_bounded(const numv_t xx, const numv_t yy)
+{
+    return as_long4(xx + yy) < 0x4000000000000000;
+}
+
+inline maskv_t numv_inside(const numv_t x, const numv_t y)
+{
+    return (maskv_t)(0);
+}
+#endif // __OPENCL_VERSION__ && VECTOR_WIDTH
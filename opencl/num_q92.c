@@ -0,0 +1,261 @@
+// Number operations in Q4.92 fixed-point, for opencl/mandelbrot_calc.c.
+// Each number is three 32-bit limbs in two's complement, so that only 32-bit
+// multiplies are needed. Points are given in Q4.124, as for
+// opencl/num_r128.c, and have their lowest limb dropped.
+
+typedef struct {
+    uint w0;
+    uint w1;
+    uint w2; // Most significant.
+} q92;
+
+typedef ulong4 point_t; // (real, imaginary)
+typedef q92 num_t;
+
+inline q92 q92FromR128(const ulong2 a)
+{
+    q92 r;
+    r.w0 = (uint)(a.lo >> 32);
+    r.w1 = (uint)a.hi;
+    r.w2 = (uint)(a.hi >> 32);
+    return r;
+}
+
+inline q92 q92Add(const q92 a, const q92 b)
+{
+    q92 r;
+    ulong s = (ulong)a.w0 + b.w0;
+    r.w0 = (uint)s;
+    s = (s >> 32) + a.w1 + b.w1;
+    r.w1 = (uint)s;
+    r.w2 = (uint)(s >> 32) + a.w2 + b.w2;
+    return r;
+}
+
+// A borrow leaves the top bit of s set.
+inline q92 q92Sub(const q92 a, const q92 b)
+{
+    q92 r;
+    ulong s = (ulong)a.w0 - b.w0;
+    r.w0 = (uint)s;
+    s = (ulong)a.w1 - b.w1 - (s >> 63);
+    r.w1 = (uint)s;
+    r.w2 = a.w2 - b.w2 - (uint)(s >> 63);
+    return r;
+}
+
+inline q92 q92Neg(const q92 a)
+{
+    const q92 zero = {0, 0, 0};
+    return q92Sub(zero, a);
+}
+
+// The product of two Q4.92 magnitudes is 192 bits, of which bits 92 to 187
+// are kept. Each 32x32-bit product is widened to 64 bits, and the products
+// are summed column by column, from the second lowest 32-bit word up.
+inline q92 q92__umul(const q92 a, const q92 b)
+{
+    const ulong p00 = (ulong)a.w0 * b.w0;
+    const ulong p01 = (ulong)a.w0 * b.w1;
+    const ulong p02 = (ulong)a.w0 * b.w2;
+    const ulong p10 = (ulong)a.w1 * b.w0;
+    const ulong p11 = (ulong)a.w1 * b.w1;
+    const ulong p12 = (ulong)a.w1 * b.w2;
+    const ulong p20 = (ulong)a.w2 * b.w0;
+    const ulong p21 = (ulong)a.w2 * b.w1;
+    const ulong p22 = (ulong)a.w2 * b.w2;
+
+    ulong col = (p00 >> 32) + (uint)p01 + (uint)p10;
+    col = (col >> 32) + (p01 >> 32) + (p10 >> 32) + (uint)p02 + (uint)p11 + (uint)p20;
+    const uint w2 = (uint)col;
+    col = (col >> 32) + (p02 >> 32) + (p11 >> 32) + (p20 >> 32) + (uint)p12 + (uint)p21;
+    const uint w3 = (uint)col;
+    col = (col >> 32) + (p12 >> 32) + (p21 >> 32) + (uint)p22;
+    const uint w4 = (uint)col;
+    const uint w5 = (uint)((col >> 32) + (p22 >> 32));
+
+    q92 r;
+    r.w0 = (w2 >> 28) | (w3 << 4);
+    r.w1 = (w3 >> 28) | (w4 << 4);
+    r.w2 = (w4 >> 28) | (w5 << 4);
+    return r;
+}
+
+inline q92 q92Mul(const q92 a, const q92 b)
+{
+    const int na = (int)a.w2 < 0;
+    const int nb = (int)b.w2 < 0;
+
+    const q92 c = q92__umul(na ? q92Neg(a) : a, nb ? q92Neg(b) : b);
+    return na != nb ? q92Neg(c) : c;
+}
+
+inline q92 q92Square(const q92 a)
+{
+    const q92 ta = (int)a.w2 < 0 ? q92Neg(a) : a;
+    return q92__umul(ta, ta);
+}
+
+inline num_t num_re(const point_t p) { return q92FromR128(p.lo); }
+inline num_t num_im(const point_t p) { return q92FromR128(p.hi); }
+inline num_t num_add(const num_t a, const num_t b) { return q92Add(a, b); }
+inline num_t num_sub(const num_t a, const num_t b) { return q92Sub(a, b); }
+inline num_t num_mul(const num_t a, const num_t b) { return q92Mul(a, b); }
+inline num_t num_sqr(const num_t a) { return q92Square(a); }
+
+// True while a point with the given squares has not escaped, i.e. is within 2 of the origin.
+inline int num_bounded(const num_t xx, const num_t yy)
+{
+    return (int)q92Add(xx, yy).w2 < 0x40000000;
+}
+
+// True if a point is known to be in the set without iterating. No shortcut
+// is taken in fixed point.
+inline int num_inside(const num_t x, const num_t y)
+{
+    (void)x;
+    (void)y;
+    return 0;
+}
+
+#if defined(__OPENCL_VERSION__) && defined(VECTOR_WIDTH)
+// Each limb becomes a vector of four lanes. Results match the scalar
+// operations exactly.
+
+#if VECTOR_WIDTH != 4
+#error "The fixed-point kernels only come in four lanes."
+#endif
+
+typedef struct {
+    uint4 w0;
+    uint4 w1;
+    uint4 w2;
+} q92v;
+
+inline q92v q92vAdd(const q92v a, const q92v b)
+{
+    q92v r;
+    ulong4 s = convert_ulong4(a.w0) + convert_ulong4(b.w0);
+    r.w0 = convert_uint4(s);
+    s = (s >> 32) + convert_ulong4(a.w1) + convert_ulong4(b.w1);
+    r.w1 = convert_uint4(s);
+    r.w2 = convert_uint4(s >> 32) + a.w2 + b.w2;
+    return r;
+}
+
+inline q92v q92vSub(const q92v a, const q92v b)
+{
+    q92v r;
+    ulong4 s = convert_ulong4(a.w0) - convert_ulong4(b.w0);
+    r.w0 = convert_uint4(s);
+    s = convert_ulong4(a.w1) - convert_ulong4(b.w1) - (s >> 63);
+    r.w1 = convert_uint4(s);
+    r.w2 = a.w2 - b.w2 - convert_uint4(s >> 63);
+    return r;
+}
+
+// Negates the lanes of a that are negative, as q92Mul() does.
+inline q92v q92vAbs(const q92v a, const int4 negative)
+{
+    const q92v zero = {(uint4)(0), (uint4)(0), (uint4)(0)};
+    const q92v n = q92vSub(zero, a);
+
+    q92v r;
+    r.w0 = select(a.w0, n.w0, negative);
+    r.w1 = select(a.w1, n.w1, negative);
+    r.w2 = select(a.w2, n.w2, negative);
+    return r;
+}
+
+inline q92v q92v__umul(const q92v a, const q92v b)
+{
+    const ulong4 a0 = convert_ulong4(a.w0);
+    const ulong4 a1 = convert_ulong4(a.w1);
+    const ulong4 a2 = convert_ulong4(a.w2);
+    const ulong4 b0 = convert_ulong4(b.w0);
+    const ulong4 b1 = convert_ulong4(b.w1);
+    const ulong4 b2 = convert_ulong4(b.w2);
+    const ulong4 low = (ulong4)(0xFFFFFFFF);
+
+    const ulong4 p00 = a0 * b0;
+    const ulong4 p01 = a0 * b1;
+    const ulong4 p02 = a0 * b2;
+    const ulong4 p10 = a1 * b0;
+    const ulong4 p11 = a1 * b1;
+    const ulong4 p12 = a1 * b2;
+    const ulong4 p20 = a2 * b0;
+    const ulong4 p21 = a2 * b1;
+    const ulong4 p22 = a2 * b2;
+
+    ulong4 col = (p00 >> 32) + (p01 & low) + (p10 & low);
+    col = (col >> 32) + (p01 >> 32) + (p10 >> 32) + (p02 & low) + (p11 & low) + (p20 & low);
+    const uint4 w2 = convert_uint4(col & low);
+    col = (col >> 32) + (p02 >> 32) + (p11 >> 32) + (p20 >> 32) + (p12 & low) + (p21 & low);
+    const uint4 w3 = convert_uint4(col & low);
+    col = (col >> 32) + (p12 >> 32) + (p21 >> 32) + (p22 & low);
+    const uint4 w4 = convert_uint4(col & low);
+    const uint4 w5 = convert_uint4(((col >> 32) + (p22 >> 32)) & low);
+
+    q92v r;
+    r.w0 = (w2 >> 28) | (w3 << 4);
+    r.w1 = (w3 >> 28) | (w4 << 4);
+    r.w2 = (w4 >> 28) | (w5 << 4);
+    return r;
+}
+
+inline q92v q92vMul(const q92v a, const q92v b)
+{
+    const int4 na = as_int4(a.w2) < 0;
+    const int4 nb = as_int4(b.w2) < 0;
+
+    return q92vAbs(q92v__umul(q92vAbs(a, na), q92vAbs(b, nb)), na ^ nb);
+}
+
+inline q92v q92vSquare(const q92v a)
+{
+    const q92v ta = q92vAbs(a, as_int4(a.w2) < 0);
+    return q92v__umul(ta, ta);
+}
+
+typedef q92v numv_t;
+typedef int4 maskv_t;
+typedef uint4 uintv;
+#define VSTORE_UINTV vstore4
+#define CONVERT_UINTV convert_uint4
+
+// Each point is (real.lo, real.hi, imag.lo, imag.hi).
+inline numv_t numv_load_re(const __global point_t *c_pt, int id)
+{
+    const ulong16 points = vload16(id, (const __global ulong *)c_pt);
+    numv_t r;
+    r.w0 = convert_uint4(points.even.even >> 32);
+    r.w1 = convert_uint4(points.odd.even & 0xFFFFFFFF);
+    r.w2 = convert_uint4(points.odd.even >> 32);
+    return r;
+}
+
+inline numv_t numv_load_im(const __global point_t *c_pt, int id)
+{
+    const ulong16 points = vload16(id, (const __global ulong *)c_pt);
+    numv_t r;
+    r.w0 = convert_uint4(points.even.odd >> 32);
+    r.w1 = convert_uint4(points.odd.odd & 0xFFFFFFFF);
+    r.w2 = convert_uint4(points.odd.odd >> 32);
+    return r;
+}
+
+inline numv_t numv_add(const numv_t a, const numv_t b) { return q92vAdd(a, b); }
+inline numv_t numv_sub(const numv_t a, const numv_t b) { return q92vSub(a, b); }
+inline numv_t numv_mul(const numv_t a, const numv_t b) { return q92vMul(a, b); }
+inline numv_t numv_sqr(const numv_t a) { return q92vSquare(a); }
+
+inline maskv_t numv_bounded(const numv_t xx, const numv_t yy)
+{
+    return as_int4(q92vAdd(xx, yy).w2) < 0x40000000;
+}
+
+inline maskv_t numv_inside(const numv_t x, const numv_t y)
+{
+    return (maskv_t)(0);
+}
+#endif // __OPENCL_VERSION__ && VECTOR_WIDTH
@@ -0,0 +1,251 @@
+// Number operations in Q4.124 fixed-point, for opencl/mandelbrot_calc.c.
+// Each number is a ulong2 of (low, high) 64-bit halves.
+
+typedef ulong4 point_t; // (real, imaginary)
+typedef ulong2 num_t;
+
+inline ulong2 r128Add(const ulong2 a, const ulong2 b)
+{
+    ulong2 dst;
+    dst.lo = a.lo + b.lo;
+    dst.hi = a.hi + b.hi + (dst.lo < a.lo);
+    return dst;
+}
+
+inline ulong2 r128Sub(const ulong2 a, const ulong2 b)
+{
+    ulong2 dst;
+    dst.lo = a.lo - b.lo;
+    dst.hi = a.hi - b.hi - (dst.lo > a.lo);
+    return dst;
+}
+
+// Negates a. Multiplication works on magnitudes, so signs are applied around it.
+inline ulong2 r128Neg(const ulong2 a)
+{
+    ulong2 r;
+    r.lo = ~a.lo + 1;
+    r.hi = ~a.hi + (a.lo == 0);
+    return r;
+}
+
+// The product of two Q4.124 magnitudes is 256 bits, of which bits 124 to 251
+// are kept. Counting 64-bit words from the bottom, the lowest word is never
+// needed, so it is never calculated; mul_hi() gives the high half of each
+// 64x64 product directly.
+// Magnitudes are below 2^127, so the high half of any product involving a.hi
+// or b.hi is below 2^63 and can take a small carry without overflowing.
+inline ulong2 r128__umul(const ulong2 a, const ulong2 b)
+{
+    const ulong lh = a.lo * b.hi;
+    const ulong hl = a.hi * b.lo;
+    const ulong hh = a.hi * b.hi;
+
+    ulong w1 = mul_hi(a.lo, b.lo) + lh;
+    ulong carry = w1 < lh;
+    w1 += hl;
+    carry += w1 < hl;
+
+    ulong w2 = mad_hi(a.hi, b.lo, carry) + mul_hi(a.lo, b.hi);
+    w2 += hh;
+    carry = w2 < hh;
+
+    const ulong w3 = mad_hi(a.hi, b.hi, carry);
+
+    ulong2 dst;
+    dst.lo = (w1 >> 60) | (w2 << 4);
+    dst.hi = (w2 >> 60) | (w3 << 4);
+    return dst;
+}
+
+// As r128__umul(a, a), with the two cross products folded into one.
+inline ulong2 r128__usquare(const ulong2 a)
+{
+    const ulong hl = a.hi * a.lo;
+    const ulong hh = a.hi * a.hi;
+
+    ulong w1 = mul_hi(a.lo, a.lo) + (hl << 1);
+    const ulong carry1 = w1 < (hl << 1);
+
+    ulong w2 = (mul_hi(a.hi, a.lo) << 1 | hl >> 63) + carry1;
+    w2 += hh;
+    const ulong carry2 = w2 < hh;
+
+    const ulong w3 = mad_hi(a.hi, a.hi, carry2);
+
+    ulong2 dst;
+    dst.lo = (w1 >> 60) | (w2 << 4);
+    dst.hi = (w2 >> 60) | (w3 << 4);
+    return dst;
+}
+
+inline ulong2 r128Mul(const ulong2 a, const ulong2 b)
+{
+    const int na = (long)a.hi < 0;
+    const int nb = (long)b.hi < 0;
+
+    const ulong2 c = r128__umul(na ? r128Neg(a) : a, nb ? r128Neg(b) : b);
+    return na != nb ? r128Neg(c) : c;
+}
+
+inline ulong2 r128Square(const ulong2 a)
+{
+    return r128__usquare((long)a.hi < 0 ? r128Neg(a) : a);
+}
+
+inline num_t num_re(const point_t p) { return p.lo; }
+inline num_t num_im(const point_t p) { return p.hi; }
+inline num_t num_add(const num_t a, const num_t b) { return r128Add(a, b); }
+inline num_t num_sub(const num_t a, const num_t b) { return r128Sub(a, b); }
+inline num_t num_mul(const num_t a, const num_t b) { return r128Mul(a, b); }
+inline num_t num_sqr(const num_t a) { return r128Square(a); }
+
+// True while a point with the given squares has not escaped, i.e. is within 2 of the origin.
+inline int num_bounded(const num_t xx, const num_t yy)
+{
+    return (long)r128Add(xx, yy).hi < 0x4000000000000000;
+}
+
+// True if a point is known to be in the set without iterating. No shortcut
+// is taken in fixed point.
+inline int num_inside(const num_t x, const num_t y)
+{
+    (void)x;
+    (void)y;
+    return 0;
+}
+
+#if defined(__OPENCL_VERSION__) && defined(VECTOR_WIDTH)
+// Each R128 is split into a vector of low halves and one of high halves, for
+// four lanes. Results match the scalar operations exactly.
+
+#if VECTOR_WIDTH != 4
+#error "The fixed-point kernels only come in four lanes."
+#endif
+
+typedef struct {
+    ulong4 lo;
+    ulong4 hi;
+} r128v;
+
+inline r128v r128vAdd(const r128v a, const r128v b)
+{
+    r128v dst;
+    dst.lo = a.lo + b.lo;
+    dst.hi = a.hi + b.hi - as_ulong4(dst.lo < a.lo); // True is all ones, i.e. -1.
+    return dst;
+}
+
+inline r128v r128vSub(const r128v a, const r128v b)
+{
+    r128v dst;
+    dst.lo = a.lo - b.lo;
+    dst.hi = a.hi - b.hi + as_ulong4(dst.lo > a.lo);
+    return dst;
+}
+
+// Negates the lanes of a that are negative, as r128Mul() does.
+inline r128v r128vAbs(const r128v a, const long4 negative)
+{
+    r128v r;
+    r.lo = select(a.lo, ~a.lo + 1, negative);
+    r.hi = select(a.hi, ~a.hi - as_ulong4(a.lo == 0), negative);
+    return r;
+}
+
+inline r128v r128v__umul(const r128v a, const r128v b)
+{
+    const ulong4 lh = a.lo * b.hi;
+    const ulong4 hl = a.hi * b.lo;
+    const ulong4 hh = a.hi * b.hi;
+
+    ulong4 w1 = mul_hi(a.lo, b.lo) + lh;
+    ulong4 carry = -as_ulong4(w1 < lh);
+    w1 += hl;
+    carry -= as_ulong4(w1 < hl);
+
+    ulong4 w2 = mad_hi(a.hi, b.lo, carry) + mul_hi(a.lo, b.hi);
+    w2 += hh;
+    carry = -as_ulong4(w2 < hh);
+
+    const ulong4 w3 = mad_hi(a.hi, b.hi, carry);
+
+    r128v dst;
+    dst.lo = (w1 >> 60) | (w2 << 4);
+    dst.hi = (w2 >> 60) | (w3 << 4);
+    return dst;
+}
+
+inline r128v r128v__usquare(const r128v a)
+{
+    const ulong4 hl = a.hi * a.lo;
+    const ulong4 hh = a.hi * a.hi;
+
+    ulong4 w1 = mul_hi(a.lo, a.lo) + (hl << 1);
+    const ulong4 carry1 = -as_ulong4(w1 < (hl << 1));
+
+    ulong4 w2 = (mul_hi(a.hi, a.lo) << 1 | hl >> 63) + carry1;
+    w2 += hh;
+    const ulong4 carry2 = -as_ulong4(w2 < hh);
+
+    const ulong4 w3 = mad_hi(a.hi, a.hi, carry2);
+
+    r128v dst;
+    dst.lo = (w1 >> 60) | (w2 << 4);
+    dst.hi = (w2 >> 60) | (w3 << 4);
+    return dst;
+}
+
+inline r128v r128vMul(const r128v a, const r128v b)
+{
+    const long4 na = as_long4(a.hi) < 0;
+    const long4 nb = as_long4(b.hi) < 0;
+
+    return r128vAbs(r128v__umul(r128vAbs(a, na), r128vAbs(b, nb)), na ^ nb);
+}
+
+inline r128v r128vSquare(const r128v a)
+{
+    return r128v__usquare(r128vAbs(a, as_long4(a.hi) < 0));
+}
+
+typedef r128v numv_t;
+typedef long4 maskv_t;
+typedef uint4 uintv;
+#define VSTORE_UINTV vstore4
+#define CONVERT_UINTV convert_uint4
+
+// Each point is (real.lo, real.hi, imag.lo, imag.hi).
+inline numv_t numv_load_re(const __global point_t *c_pt, int id)
+{
+    const ulong16 points = vload16(id, (const __global ulong *)c_pt);
+    numv_t r;
+    r.lo = points.even.even;
+    r.hi = points.odd.even;
+    return r;
+}
+
+inline numv_t numv_load_im(const __global point_t *c_pt, int id)
+{
+    const ulong16 points = vload16(id, (const __global ulong *)c_pt);
+    numv_t r;
+    r.lo = points.even.odd;
+    r.hi = points.odd.odd;
+    return r;
+}
+
+inline numv_t numv_add(const numv_t a, const numv_t b) { return r128vAdd(a, b); }
+inline numv_t numv_sub(const numv_t a, const numv_t b) { return r128vSub(a, b); }
+inline numv_t numv_mul(const numv_t a, const numv_t b) { return r128vMul(a, b); }
+inline numv_t numv_sqr(const numv_t a) { return r128vSquare(a); }
+
+inline maskv_t numv_bounded(const numv_t xx, const numv_t yy)
+{
+    return as_long4(r128vAdd(xx, yy).hi) < 0x4000000000000000;
+}
+
+inline maskv_t numv_inside(const numv_t x, const numv_t y)
+{
+    return (maskv_t)(0);
+}
+#endif // __OPENCL_VERSION__ && VECTOR_WIDTH
@@ -279,7 +279,7 @@ static void r128__umul128(R128 *dst, R128_U64 a, R128_U64 b)
       carry = ((R128_U64)(R128_U32)p1 + (R128_U64)(R128_U32)p2 + (p0 >> 32)) >> 32;
 
       lo = p0 + ((p1 + p2) << 32);
-      hi = p3 + ((R128_U32)(p1 >> 32) + (R128_U32)(p2 >> 32)) + carry;
+      hi = p3 + ((R128_U64)(R128_U32)(p1 >> 32) + (R128_U32)(p2 >> 32)) + carry;
 
       R128_SET2(dst, lo, hi);
    }
@@ -313,19 +313,25 @@ static void r128__umul(R128 *dst, const R128 *a, const R128 *b)
    r128__umul128(&albh, a->lo, b->hi);
    r128__umul128(&ahbh, a->hi, b->hi);
 
-   R128 sum;
+   // The product is 256 bits (w0 to w3, from the bottom), of which bits 124
+   // to 251 are kept.
+   R128_U64 w1, w2, w3, carry;
 
-   r128Shr(&ahbh, &ahbh, 60);
-   sum.lo = 0;
-   sum.hi = ahbh.lo;
+   w1 = albl.hi + ahbl.lo;
+   carry = w1 < ahbl.lo;
+   w1 += albh.lo;
+   carry += w1 < albh.lo;
 
-   albl.lo = albl.hi;
-   albl.hi = 0;
-   r128Add(&sum, &sum, &albl);
-   r128Add(&sum, &sum, &ahbl);
-   r128Add(&sum, &sum, &albh);
+   w2 = ahbl.hi + carry;
+   carry = w2 < carry;
+   w2 += albh.hi;
+   carry += w2 < albh.hi;
+   w2 += ahbh.lo;
+   carry += w2 < ahbh.lo;
 
-   R128_SET2(dst, sum.lo, sum.hi);
+   w3 = ahbh.hi + carry;
+
+   R128_SET2(dst, (w1 >> 60) | (w2 << 4), (w2 >> 60) | (w3 << 4));
 }
 
 void r128FromInt(R128 *dst, R128_S64 v)
@@ -385,7 +391,7 @@ double r128ToFloat(const R128 *v)
    }
 
    d = (tmp.hi >> 60);
-   d += (tmp.hi & 0xFFFFFFFFFFFFFF) / (double)((uint64_t)1 << 60);
+   d += (tmp.hi & 0xFFFFFFFFFFFFFFF) / (double)((uint64_t)1 << 60);
    d += tmp.lo / (double)((uint64_t)1 << 60) / 18446744073709551616.0;
    
    if (sign) {
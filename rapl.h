@@ -0,0 +1,102 @@
+/**
+ * happy-fractal - A study of efficient and precise fractal rendering.
+ * Copyright (C) 2022  Clyne Sullivan
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef HAPPY_FRACTAL_RAPL_H
+#define HAPPY_FRACTAL_RAPL_H
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "topology.h"
+
+/**
+ * Measures the energy used by the CPU packages, through the RAPL counters
+ * that the kernel exposes under /sys/class/powercap.
+ * Only the top-level zones (one per package) are read, since their subzones
+ * (cores, uncore, DRAM) are already included in them.
+ */
+class EnergyMeter
+{
+public:
+    explicit EnergyMeter(const std::string& root = "/sys/class/powercap");
+
+    // False if there are no counters, or they can't be read (reading them
+    // usually requires root).
+    bool available() const;
+
+    // Returns the joules used since this meter was created.
+    // The counters wrap around every few minutes under load, so this must be
+    // called at least that often to stay accurate.
+    double joules();
+
+private:
+    struct Zone {
+        std::string path;
+        uint64_t max; // The counter's range, in microjoules.
+        uint64_t last;
+    };
+
+    std::vector<Zone> m_zones;
+    uint64_t m_total; // In microjoules.
+};
+
+inline EnergyMeter::EnergyMeter(const std::string& root):
+    m_total(0)
+{
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(root, ec)) {
+        const auto name = entry.path().filename().string();
+
+        // Top-level zones are named like "intel-rapl:0"; subzones add another ":N".
+        // Platform (psys) zones overlap the packages, so are skipped too.
+        if (!name.starts_with("intel-rapl:") || name.find(':') != name.rfind(':'))
+            continue;
+        if (readSysfs(entry.path() / "name") == "psys")
+            continue;
+
+        const auto energy = readSysfs(entry.path() / "energy_uj");
+        const auto max = readSysfs(entry.path() / "max_energy_range_uj");
+        if (energy.empty() || max.empty())
+            continue;
+
+        m_zones.push_back({entry.path() / "energy_uj", std::stoull(max), std::stoull(energy)});
+    }
+}
+
+inline bool EnergyMeter::available() const {
+    return !m_zones.empty();
+}
+
+inline double EnergyMeter::joules()
+{
+    for (auto& zone : m_zones) {
+        const auto line = readSysfs(zone.path);
+        if (line.empty())
+            continue;
+
+        const uint64_t now = std::stoull(line);
+        m_total += now >= zone.last ? now - zone.last : zone.max - zone.last + now;
+        zone.last = now;
+    }
+
+    return m_total / 1e6;
+}
+
+#endif // HAPPY_FRACTAL_RAPL_H
@@ -0,0 +1,186 @@
+/**
+ * happy-fractal - A study of efficient and precise fractal rendering.
+ * Copyright (C) 2022  Clyne Sullivan
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef HAPPY_FRACTAL_TASK_H
+#define HAPPY_FRACTAL_TASK_H
+
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <stop_token>
+#include <utility>
+
+#include "worker_pool.h"
+
+/**
+ * A lazily-started coroutine. It begins running when it is co_await'ed, and
+ * resumes the awaiting coroutine when it finishes. Exceptions are passed on
+ * to the awaiting coroutine.
+ */
+class Task
+{
+public:
+    struct promise_type {
+        std::coroutine_handle<> continuation;
+        std::exception_ptr exception;
+
+        Task get_return_object() {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+
+        auto final_suspend() noexcept {
+            struct FinalAwaiter {
+                bool await_ready() noexcept {
+                    return false;
+                }
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+                    auto next = h.promise().continuation;
+                    return next ? next : std::noop_coroutine();
+                }
+                void await_resume() noexcept {}
+            };
+
+            return FinalAwaiter {};
+        }
+
+        void return_void() {}
+
+        void unhandled_exception() {
+            exception = std::current_exception();
+        }
+    };
+
+    Task(Task&& other):
+        m_handle(std::exchange(other.m_handle, nullptr)) {}
+    Task(const Task&) = delete;
+
+    ~Task() {
+        if (m_handle)
+            m_handle.destroy();
+    }
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        m_handle.promise().continuation = awaiting;
+        return m_handle;
+    }
+
+    void await_resume() {
+        if (m_handle.promise().exception)
+            std::rethrow_exception(m_handle.promise().exception);
+    }
+
+private:
+    std::coroutine_handle<promise_type> m_handle;
+
+    explicit Task(std::coroutine_handle<promise_type> handle):
+        m_handle(handle) {}
+};
+
+namespace detail {
+    // A coroutine that starts immediately and cleans up after itself.
+    struct Detached {
+        struct promise_type {
+            Detached get_return_object() {
+                return {};
+            }
+            std::suspend_never initial_suspend() noexcept {
+                return {};
+            }
+            std::suspend_never final_suspend() noexcept {
+                return {};
+            }
+            void return_void() {}
+            void unhandled_exception() {
+                std::terminate();
+            }
+        };
+    };
+
+    inline Detached runDetached(Task task, std::function<void()> done) {
+        co_await task;
+        done();
+    }
+}
+
+// Starts the given task without waiting for it. done is called from
+// whichever thread finishes the task.
+inline void spawn(Task task, std::function<void()> done)
+{
+    detail::runDetached(std::move(task), std::move(done));
+}
+
+// Moves the awaiting coroutine onto one of the pool's workers.
+inline auto schedule(WorkerPool& pool, WorkerPool::Priority priority)
+{
+    struct Awaiter {
+        WorkerPool& pool;
+        WorkerPool::Priority priority;
+
+        bool await_ready() const noexcept {
+            return false;
+        }
+        void await_suspend(std::coroutine_handle<> h) {
+            pool.submit(1, [h](unsigned int, unsigned int) { h.resume(); }, [] {}, priority);
+        }
+        void await_resume() const noexcept {}
+    };
+
+    return Awaiter {pool, priority};
+}
+
+// Runs func over tiles [0, tileCount) on the pool, in order of rank if given.
+// The awaiting coroutine is resumed by the worker that finishes the last tile.
+// Once stop is requested, tiles that have not started yet are skipped.
+inline auto forEachTile(WorkerPool& pool, unsigned int tileCount, WorkerPool::TileFunc func, std::stop_token stop,
+                        WorkerPool::Priority priority, WorkerPool::RankFunc rank = {})
+{
+    struct Awaiter {
+        WorkerPool& pool;
+        unsigned int tileCount;
+        WorkerPool::TileFunc func;
+        std::stop_token stop;
+        WorkerPool::Priority priority;
+        WorkerPool::RankFunc rank;
+
+        bool await_ready() const noexcept {
+            return false;
+        }
+        void await_suspend(std::coroutine_handle<> h) {
+            pool.submit(tileCount,
+                [func = std::move(func), stop = std::move(stop)](unsigned int tile, unsigned int worker) {
+                    if (!stop.stop_requested())
+                        func(tile, worker);
+                },
+                [h] { h.resume(); },
+                priority, rank);
+        }
+        void await_resume() const noexcept {}
+    };
+
+    return Awaiter {pool, tileCount, std::move(func), std::move(stop), priority, std::move(rank)};
+}
+
+#endif // HAPPY_FRACTAL_TASK_H
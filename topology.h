@@ -0,0 +1,127 @@
+/**
+ * happy-fractal - A study of efficient and precise fractal rendering.
+ * Copyright (C) 2022  Clyne Sullivan
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef HAPPY_FRACTAL_TOPOLOGY_H
+#define HAPPY_FRACTAL_TOPOLOGY_H
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+/**
+ * The CPUs of the machine as the kernel reports them through sysfs.
+ */
+struct CpuTopology {
+    // The CPUs belonging to each NUMA node.
+    std::vector<std::vector<int>> nodes;
+    // The hardware threads (SMT siblings) of each physical core. Cores are
+    // listed in node order.
+    std::vector<std::vector<int>> cores;
+    // The node of each entry in cores.
+    std::vector<unsigned int> coreNodes;
+
+    // Reads the topology of this machine. If sysfs can't tell us anything,
+    // every CPU is placed in a single node.
+    static CpuTopology detect();
+};
+
+// Parses a kernel CPU list such as "0-3,8-11".
+inline std::vector<int> parseCpuList(const std::string& list)
+{
+    std::vector<int> cpus;
+    std::istringstream iss (list);
+
+    for (std::string range; std::getline(iss, range, ',');) {
+        if (range.empty() || range == "\n")
+            continue;
+
+        const auto dash = range.find('-');
+        const int first = std::stoi(range.substr(0, dash));
+        const int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for (int cpu = first; cpu <= last; ++cpu)
+            cpus.push_back(cpu);
+    }
+
+    return cpus;
+}
+
+// Reads a single line from a sysfs file. Returns an empty string on failure.
+inline std::string readSysfs(const std::string& path)
+{
+    std::ifstream file (path);
+    std::string line;
+    std::getline(file, line);
+    return line;
+}
+
+inline CpuTopology CpuTopology::detect()
+{
+    CpuTopology topo;
+
+    for (int node = 0; ; ++node) {
+        auto cpus = parseCpuList(readSysfs("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"));
+        if (cpus.empty())
+            break;
+
+        topo.nodes.push_back(std::move(cpus));
+    }
+
+    if (topo.nodes.empty()) {
+        topo.nodes.emplace_back();
+        for (unsigned int cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); ++cpu)
+            topo.nodes.back().push_back(cpu);
+    }
+
+    std::vector<int> seen;
+    for (unsigned int node = 0; node < topo.nodes.size(); ++node) {
+        for (int cpu : topo.nodes[node]) {
+            if (std::find(seen.begin(), seen.end(), cpu) != seen.end())
+                continue;
+
+            auto siblings = parseCpuList(readSysfs("/sys/devices/system/cpu/cpu" + std::to_string(cpu) +
+                                                   "/topology/thread_siblings_list"));
+            if (std::find(siblings.begin(), siblings.end(), cpu) == siblings.end())
+                siblings.assign(1, cpu);
+
+            seen.insert(seen.end(), siblings.begin(), siblings.end());
+            topo.cores.push_back(std::move(siblings));
+            topo.coreNodes.push_back(node);
+        }
+    }
+
+    return topo;
+}
+
+// Restricts the calling thread to the given CPUs.
+inline void bindThisThread(const std::vector<int>& cpus)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+        CPU_SET(cpu, &set);
+
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+#endif // HAPPY_FRACTAL_TOPOLOGY_H
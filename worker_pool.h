@@ -0,0 +1,370 @@
+/**
+ * happy-fractal - A study of efficient and precise fractal rendering.
+ * Copyright (C) 2022  Clyne Sullivan
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef HAPPY_FRACTAL_WORKER_POOL_H
+#define HAPPY_FRACTAL_WORKER_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <latch>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include "arena.h"
+#include "topology.h"
+
+/**
+ * A fixed set of worker threads, grouped and bound by NUMA node.
+ *
+ * Workers are bound to one hardware thread each. Every physical core gets a
+ * worker before any core gets a second one on its SMT sibling, since the
+ * kernels are bound by multiplier throughput that siblings would share.
+ *
+ * Work is submitted as a number of tiles. Each node owns a fixed, contiguous
+ * share of the tiles, so the same node always writes the same part of a
+ * frame and that memory stays local to it after the first touch. Shares are
+ * weighted by the measured speed of each node's workers, so slower (e.g.
+ * efficiency) cores are given less. A worker that runs out of tiles on its
+ * own node steals from the other nodes.
+ *
+ * Any number of jobs may be in flight at once, e.g. from several views
+ * sharing the pool. Workers claim one tile at a time, taking turns between
+ * the jobs, so each job gets an equal share of the workers no matter when it
+ * was submitted.
+ *
+ * Jobs have a priority. Tiles are only claimed from the highest priority
+ * jobs in flight, so an interactive job takes over the pool from batch jobs
+ * as soon as their current tiles are done.
+ *
+ * Jobs may also rank their tiles, e.g. by distance from where the user is
+ * looking. Each node then claims its share of the tiles in rank order.
+ */
+class WorkerPool
+{
+public:
+    // Called with the tile index and the index of the worker running it.
+    using TileFunc = std::function<void(unsigned int, unsigned int)>;
+    // Called by the worker that completes a job's last tile.
+    using DoneFunc = std::function<void()>;
+    // Returns the rank of the given tile. Lower ranks are claimed first.
+    using RankFunc = std::function<unsigned int(unsigned int)>;
+
+    // Lower values are served first.
+    enum class Priority : unsigned int {
+        Interactive,
+        Batch,
+        Count
+    };
+
+    // Work completed at a priority since the pool was created.
+    struct Stats {
+        uint64_t tiles;
+        double seconds; // Summed over all workers.
+    };
+
+    // Spawns the given number of workers, or one per physical core if zero.
+    WorkerPool(const CpuTopology& topo, unsigned int workerCount, std::size_t scratchSize);
+    // Joins all workers.
+    ~WorkerPool();
+
+    unsigned int size() const;
+    unsigned int nodeCount() const;
+    // Relative speed of the given worker, from 0 to 1 (the fastest worker).
+    double speed(unsigned int worker) const;
+
+    // The scratch arena of the given worker. It is reset before each tile, so
+    // it should only be used from within a TileFunc.
+    Arena& scratch(unsigned int worker);
+
+    // Calls func for each tile in [0, tileCount), then calls done.
+    // Returns immediately.
+    void submit(unsigned int tileCount, TileFunc func, DoneFunc done, Priority priority = Priority::Interactive,
+                const RankFunc& rank = {});
+    // Calls func for each tile in [0, tileCount), and returns once all are done.
+    void run(unsigned int tileCount, const TileFunc& func, Priority priority = Priority::Interactive);
+
+    Stats stats(Priority priority) const;
+
+private:
+    // Guarded by m_lock.
+    struct NodeShare {
+        std::vector<unsigned int> tiles; // In the order they are to be claimed.
+        std::size_t next = 0;
+    };
+
+    struct Job {
+        TileFunc func;
+        DoneFunc done;
+        Priority priority;
+        std::unique_ptr<NodeShare[]> shares;
+        std::atomic_uint remaining;
+    };
+
+    std::vector<std::thread> m_threads;
+    std::vector<int> m_worker_cpu;
+    std::vector<unsigned int> m_worker_node;
+    std::vector<double> m_worker_speed; // Multiplies per second.
+    std::vector<std::unique_ptr<Arena>> m_scratch;
+    std::vector<std::vector<int>> m_nodes;
+
+    std::mutex m_lock;
+    std::condition_variable m_wake; // Signals workers that a job is ready.
+    std::vector<std::shared_ptr<Job>> m_jobs; // Jobs with tiles left to claim.
+    std::size_t m_next_job = 0;               // The job to claim a tile from next.
+    bool m_stop = false;
+
+    std::atomic_uint64_t m_tiles[static_cast<unsigned int>(Priority::Count)] = {};
+    std::atomic_uint64_t m_nanoseconds[static_cast<unsigned int>(Priority::Count)] = {};
+
+    // Enters the main loop of a worker.
+    void workerThread(unsigned int worker, std::size_t scratchSize, std::latch& ready);
+    // Picks the job to claim a tile from next: the next in turn among those
+    // of the highest priority. m_jobs must not be empty.
+    std::shared_ptr<Job> pick();
+    // Claims a tile of the given job for the given worker, preferring the
+    // worker's own node. Returns false if no tiles are left to claim.
+    bool claim(Job& job, unsigned int worker, unsigned int& tile);
+};
+
+// Times a burst of 64x64-bit multiplies, the core operation of the R128 kernel.
+// Returns multiplies per second.
+inline double measureMultiplyThroughput()
+{
+    constexpr unsigned int ROUNDS = 1 << 18;
+    // Independent chains, so this measures throughput rather than latency.
+    uint64_t x[4] = {0x9E3779B97F4A7C15, 0xBF58476D1CE4E5B9, 0x94D049BB133111EB, 0x2545F4914F6CDD1D};
+
+    const auto start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < ROUNDS; ++i) {
+        for (auto& v : x) {
+            const auto p = static_cast<unsigned __int128>(v) * (v | 1);
+            v = static_cast<uint64_t>(p >> 64) ^ static_cast<uint64_t>(p);
+        }
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    volatile uint64_t sink = x[0] ^ x[1] ^ x[2] ^ x[3];
+    (void)sink;
+    return ROUNDS * 4 / elapsed.count();
+}
+
+inline WorkerPool::WorkerPool(const CpuTopology& topo, unsigned int workerCount, std::size_t scratchSize):
+    m_nodes(topo.nodes)
+{
+    // Every core's first thread, then every core's second thread, and so on.
+    for (unsigned int sibling = 0; ; ++sibling) {
+        const auto before = m_worker_cpu.size();
+        for (unsigned int c = 0; c < topo.cores.size(); ++c) {
+            if (sibling < topo.cores[c].size()) {
+                m_worker_cpu.push_back(topo.cores[c][sibling]);
+                m_worker_node.push_back(topo.coreNodes[c]);
+            }
+        }
+
+        if (m_worker_cpu.size() == before)
+            break;
+        else if (workerCount == 0)
+            workerCount = m_worker_cpu.size();
+    }
+
+    // More workers than hardware threads just wrap around.
+    for (unsigned int w = m_worker_cpu.size(); w < workerCount; ++w) {
+        m_worker_cpu.push_back(m_worker_cpu[w % topo.cores.size()]);
+        m_worker_node.push_back(m_worker_node[w % topo.cores.size()]);
+    }
+    m_worker_cpu.resize(workerCount);
+    m_worker_node.resize(workerCount);
+    m_worker_speed.resize(workerCount);
+
+    // Wait for each worker to measure its speed before accepting work.
+    std::latch ready (workerCount);
+    m_scratch.resize(workerCount);
+    for (unsigned int w = 0; w < workerCount; ++w)
+        m_threads.emplace_back([this, w, scratchSize, &ready] { workerThread(w, scratchSize, ready); });
+    ready.wait();
+}
+
+inline WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard lock (m_lock);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+
+    for (auto& t : m_threads)
+        t.join();
+}
+
+inline unsigned int WorkerPool::size() const {
+    return m_threads.size();
+}
+
+inline unsigned int WorkerPool::nodeCount() const {
+    return m_nodes.size();
+}
+
+inline double WorkerPool::speed(unsigned int worker) const {
+    return m_worker_speed[worker] / *std::max_element(m_worker_speed.begin(), m_worker_speed.end());
+}
+
+inline Arena& WorkerPool::scratch(unsigned int worker) {
+    return *m_scratch[worker];
+}
+
+inline void WorkerPool::submit(unsigned int tileCount, TileFunc func, DoneFunc done, Priority priority,
+                               const RankFunc& rank)
+{
+    if (tileCount == 0) {
+        done();
+        return;
+    }
+
+    auto job = std::make_shared<Job>();
+    job->func = std::move(func);
+    job->done = std::move(done);
+    job->priority = priority;
+    job->remaining = tileCount;
+    job->shares.reset(new NodeShare[m_nodes.size()]);
+
+    // Give each node a share of the tiles that matches its share of speed.
+    double total = 0;
+    for (auto s : m_worker_speed)
+        total += s;
+
+    double upto = 0;
+    for (unsigned int n = 0, begin = 0; n < m_nodes.size(); ++n) {
+        for (unsigned int w = 0; w < size(); ++w)
+            upto += m_worker_node[w] == n ? m_worker_speed[w] : 0;
+
+        const unsigned int end = n + 1 == m_nodes.size() ? tileCount : tileCount * upto / total;
+        auto& tiles = job->shares[n].tiles;
+        tiles.resize(end - begin);
+        std::iota(tiles.begin(), tiles.end(), begin);
+
+        if (rank) {
+            std::vector<unsigned int> ranks (tiles.size());
+            std::transform(tiles.begin(), tiles.end(), ranks.begin(), rank);
+            std::ranges::sort(tiles, {}, [&ranks, begin](unsigned int t) { return ranks[t - begin]; });
+        }
+
+        begin = end;
+    }
+
+    {
+        std::lock_guard lock (m_lock);
+        m_jobs.push_back(std::move(job));
+    }
+    m_wake.notify_all();
+}
+
+inline void WorkerPool::run(unsigned int tileCount, const TileFunc& func, Priority priority)
+{
+    std::latch finished (1);
+    submit(tileCount, func, [&finished] { finished.count_down(); }, priority);
+    finished.wait();
+}
+
+inline WorkerPool::Stats WorkerPool::stats(Priority priority) const
+{
+    const auto p = static_cast<unsigned int>(priority);
+    return {m_tiles[p].load(), m_nanoseconds[p].load() * 1e-9};
+}
+
+inline void WorkerPool::workerThread(unsigned int worker, std::size_t scratchSize, std::latch& ready)
+{
+    // Bind before the scratch arena is first touched, so it is node-local.
+    bindThisThread({m_worker_cpu[worker]});
+    m_scratch[worker] = std::make_unique<Arena>(scratchSize, MemoryUse::Scratch);
+
+    // All workers measure at once, so SMT siblings see their shared speed.
+    m_worker_speed[worker] = measureMultiplyThroughput();
+    ready.count_down();
+
+    std::unique_lock lock (m_lock);
+
+    while (true) {
+        m_wake.wait(lock, [this] { return m_stop || !m_jobs.empty(); });
+        if (m_stop)
+            break;
+
+        auto job = pick();
+        unsigned int tile;
+        if (!claim(*job, worker, tile)) {
+            // Everything is claimed; the job only needs its last tiles to finish.
+            std::erase(m_jobs, job);
+            continue;
+        }
+
+        lock.unlock();
+
+        m_scratch[worker]->reset();
+
+        const auto start = std::chrono::steady_clock::now();
+        job->func(tile, worker);
+        const auto p = static_cast<unsigned int>(job->priority);
+        m_nanoseconds[p] += std::chrono::nanoseconds(std::chrono::steady_clock::now() - start).count();
+        ++m_tiles[p];
+
+        if (--job->remaining == 0)
+            job->done();
+
+        lock.lock();
+    }
+}
+
+inline std::shared_ptr<WorkerPool::Job> WorkerPool::pick()
+{
+    auto top = Priority::Count;
+    for (const auto& job : m_jobs)
+        top = std::min(top, job->priority);
+
+    for (std::size_t i = 0; ; ++i) {
+        auto& job = m_jobs[(m_next_job + i) % m_jobs.size()];
+
+        if (job->priority == top) {
+            m_next_job += i + 1;
+            return job;
+        }
+    }
+}
+
+inline bool WorkerPool::claim(Job& job, unsigned int worker, unsigned int& tile)
+{
+    const unsigned int home = m_worker_node[worker];
+
+    // Drain our own node first, then steal from the others.
+    for (unsigned int i = 0; i < m_nodes.size(); ++i) {
+        auto& share = job.shares[(home + i) % m_nodes.size()];
+
+        if (share.next < share.tiles.size()) {
+            tile = share.tiles[share.next++];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+#endif // HAPPY_FRACTAL_WORKER_POOL_H